@@ -45,7 +45,8 @@
 	"-lfdt",        \
 	    "-lgvc",    \
 	    "-lcgraph", \
-	    "-lcdt"
+	    "-lcdt",    \
+	    "-lpthread"
 
 #define SOURCE_CODE_FORMATTABLE_CODE                           \
 	"find", ".",                                           \
@@ -64,15 +65,22 @@
 ////////////////////////////////////////////////////////////////////////////////
 ///	Targets
 ////////////////////////////////////////////////////////////////////////////////
-#define TARGET_DT2GV_APP         \
-	CC,                      \
-	    COMMON_CFLAGS,       \
-	    PRJ_INCLUDE_PATHS,   \
-	    EXTERNAL_LIBS_PATHS, \
-	    EXTERNAL_LIBS,       \
-	    "-o",                \
-	    "build/dt2gv",       \
-	    "src/dt2gv/dt2gv.cc"
+#define TARGET_DT2GV_APP                  \
+	CC,                               \
+	    COMMON_CFLAGS,                \
+	    PRJ_INCLUDE_PATHS,            \
+	    EXTERNAL_LIBS_PATHS,          \
+	    EXTERNAL_LIBS,                \
+	    "-o",                         \
+	    "build/dt2gv",                \
+	    "src/dt2gv/dt2gv.cc",         \
+	    "src/dt2gv/address-map.cc",   \
+	    "src/dt2gv/device-tree.cc",   \
+	    "src/common/html-view.cc",    \
+	    "src/common/layout.cc",       \
+	    "src/common/output.cc",       \
+	    "src/common/render-cache.cc", \
+	    "src/common/tiling.cc"
 #define TARGET_PS2GV_APP                    \
 	CC,                                 \
 	    COMMON_CFLAGS,                  \
@@ -82,10 +90,57 @@
 	    "-o",                           \
 	    "build/ps2gv",                  \
 	    "src/ps2gv/ps2gv.cc",           \
+	    "src/common/html-view.cc",      \
+	    "src/common/layout.cc",         \
+	    "src/common/output.cc",         \
+	    "src/common/render-cache.cc",   \
+	    "src/common/tiling.cc",         \
 	    "src/ps2gv/cli-parser.cc",      \
+	    "src/ps2gv/colour-rules.cc",    \
 	    "src/ps2gv/config-settings.cc", \
+	    "src/ps2gv/fleet-merge.cc",     \
 	    "src/ps2gv/graph-generator.cc", \
-	    "src/ps2gv/process-capture.cc"
+	    "src/ps2gv/process-capture.cc", \
+	    "src/ps2gv/process-detail.cc",  \
+	    "src/ps2gv/process-events.cc",  \
+	    "src/ps2gv/process-ipc.cc",     \
+	    "src/ps2gv/process-threads.cc", \
+	    "src/ps2gv/process-trace.cc",   \
+	    "src/ps2gv/serve.cc",           \
+	    "src/ps2gv/snapshot-diff.cc"
+// libdtv, built once as position independent objects, then archived and linked
+#define LIBDTV_SOURCES                      \
+	"src/libdtv/dtv.cc",                \
+	    "src/libdtv/dtv-c.cc",          \
+	    "src/common/html-view.cc",      \
+	    "src/common/layout.cc",         \
+	    "src/common/output.cc",         \
+	    "src/common/render-cache.cc",   \
+	    "src/common/tiling.cc",         \
+	    "src/dt2gv/device-tree.cc",     \
+	    "src/ps2gv/colour-rules.cc",    \
+	    "src/ps2gv/config-settings.cc", \
+	    "src/ps2gv/graph-generator.cc", \
+	    "src/ps2gv/process-capture.cc", \
+	    "src/ps2gv/process-detail.cc",  \
+	    "src/ps2gv/process-threads.cc", \
+	    "src/ps2gv/snapshot-diff.cc"
+#define LIBDTV_OBJ_DIR "build/libdtv"
+#define TARGET_LIBDTV_STATIC \
+	"ar", "rcs", "build/libdtv.a"
+#if defined(__APPLE__) && defined(__MACH__)
+#define TARGET_LIBDTV_SHARED \
+	CC,                  \
+	    "-dynamiclib",   \
+	    "-o",            \
+	    "build/libdtv.dylib"
+#else
+#define TARGET_LIBDTV_SHARED \
+	CC,                  \
+	    "-shared",       \
+	    "-o",            \
+	    "build/libdtv.so"
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 ///	Information/Logger symbols
@@ -134,7 +189,7 @@ void usage(const char* program)
 	nob_log(INFO, "Usage: %s [<subcommand>]", program);
 	nob_log(INFO, "Subcommands:");
 	nob_log(INFO, "		build");
-	nob_log(INFO, "			Build the applications.");
+	nob_log(INFO, "			Build the applications and libdtv.");
 	nob_log(INFO, "		format");
 	nob_log(INFO, "			Reformat codebase according to codestyle.");
 	nob_log(INFO, "		help");
@@ -144,6 +199,37 @@ void usage(const char* program)
 ////////////////////////////////////////////////////////////////////////////////
 ///	Build
 ////////////////////////////////////////////////////////////////////////////////
+bool build_libdtv(Cmd* cmd)
+{
+	static const char* sources[] = { LIBDTV_SOURCES };
+	File_Paths objects = { 0 };
+	bool result = true;
+	if (!mkdir_if_not_exists(LIBDTV_OBJ_DIR))
+		return false;
+	// basenames are unique across the sources, so a flat object dir is fine
+	for (size_t i = 0; i < ARRAY_LEN(sources); ++i) {
+		const char* object = temp_sprintf(LIBDTV_OBJ_DIR "/%s.o", path_name(sources[i]));
+		cmd_append(cmd, CC, COMMON_CFLAGS, "-fPIC", PRJ_INCLUDE_PATHS, "-c", sources[i], "-o", object);
+		if (!cmd_run_sync_and_reset(cmd))
+			return_defer(false);
+		da_append(&objects, object);
+	}
+
+	cmd_append(cmd, TARGET_LIBDTV_STATIC);
+	da_append_many(cmd, objects.items, objects.count);
+	if (!cmd_run_sync_and_reset(cmd))
+		return_defer(false);
+
+	cmd_append(cmd, TARGET_LIBDTV_SHARED);
+	da_append_many(cmd, objects.items, objects.count);
+	cmd_append(cmd, EXTERNAL_LIBS_PATHS, EXTERNAL_LIBS);
+	if (!cmd_run_sync_and_reset(cmd))
+		return_defer(false);
+defer:
+	da_free(objects);
+	return result;
+}
+
 bool build(Cmd* cmd)
 {
 	Timer t;
@@ -165,6 +251,8 @@ bool build(Cmd* cmd)
 	cmd_append(cmd, TARGET_PS2GV_APP);
 	if (!cmd_run_sync_and_reset(cmd))
 		return false;
+	if (!build_libdtv(cmd))
+		return false;
 	TIMER_STOP(t);
 	TIMER_PRINT(t, "Binary build.");
 	return true;
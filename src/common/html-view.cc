@@ -0,0 +1,473 @@
+#include "common/html-view.h"
+#include "common/output.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+// One row of the node table
+struct HtmlNode {
+	double x = 0.0, y = 0.0; // centre, points, y down
+	double width = 0.0, height = 0.0;
+	bool box = false; // else an ellipse
+	long parent = -1; // first tree edge in, -1 for roots
+	std::string label, fill, tooltip, url;
+};
+
+const char* attribute(void* object, const char* name)
+{
+	const char* value = agget(object, const_cast<char*>(name));
+	return value ? value : "";
+}
+
+// DOT's own escapes (\n, \l, \r line breaks, \N for the node name)
+std::string unescape(const std::string& s, const std::string& name)
+{
+	std::string text;
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (s[i] != '\\' || i + 1 == s.size()) {
+			text += s[i];
+			continue;
+		}
+		const char next = s[++i];
+		if (next == 'n' || next == 'l' || next == 'r')
+			text += '\n';
+		else if (next == 'N')
+			text += name;
+		else
+			text += next;
+	}
+	return text;
+}
+
+// First fill colour of an xdot op list, "C 7 -#ffe4c4". xdot always
+// resolves names to hex, which is what the canvas needs.
+std::string xdot_fill(const char* ops)
+{
+	for (const char* p = ops; *p; ++p) {
+		if (*p != 'C' || p[1] != ' ' || (p != ops && p[-1] != ' '))
+			continue;
+		char* end = nullptr;
+		const long length = std::strtol(p + 2, &end, 10);
+		if (length <= 0 || end[0] != ' ' || end[1] != '-' || std::strlen(end + 2) < static_cast<size_t>(length))
+			continue;
+		if (end[2] == '#') // not a gradient
+			return std::string(end + 2, static_cast<size_t>(length));
+	}
+	return "";
+}
+
+bool is_box(const std::string& shape)
+{
+	for (const char* box : { "box", "rect", "rectangle", "square", "box3d", "folder", "tab", "note", "component", "plaintext", "plain", "none" })
+		if (shape == box)
+			return true;
+	return false;
+}
+
+// Safe inside a <script> block as well as JSON
+void json_string(std::ostream& out, const std::string& s)
+{
+	out << '"';
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c == '\n')
+			out << "\\n";
+		else if (c < 0x20 || c == '<' || c == '>' || c == '&') {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		} else
+			out << c;
+	}
+	out << '"';
+}
+
+std::string html_escape(const std::string& s)
+{
+	std::string escaped;
+	for (char c : s) {
+		if (c == '<')
+			escaped += "&lt;";
+		else if (c == '>')
+			escaped += "&gt;";
+		else if (c == '&')
+			escaped += "&amp;";
+		else
+			escaped += c;
+	}
+	return escaped;
+}
+
+// A node's tree parent is the tail of its first edge in that shapes the
+// layout, ps2gv's IPC edges and the like don't count. Loops get cut, the
+// page walks down from the roots.
+void break_cycles(std::vector<HtmlNode>& nodes)
+{
+	std::vector<char> state(nodes.size(), 0); // 0 new, 1 on this walk, 2 done
+	std::vector<size_t> walk;
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		walk.clear();
+		long j = static_cast<long>(i);
+		while (j >= 0 && state[j] == 0) {
+			state[j] = 1;
+			walk.push_back(static_cast<size_t>(j));
+			j = nodes[j].parent;
+		}
+		if (j >= 0 && state[j] == 1)
+			nodes[walk.back()].parent = -1;
+		for (size_t k : walk)
+			state[k] = 2;
+	}
+}
+
+// What an xdot render writes back onto the graph, its clusters, nodes and
+// edges. Looked up for every kind, a name a kind doesn't use just isn't there.
+const char* const XDOT_ATTRIBUTES[] = { "bb", "pos", "width", "height", "lp", "xlp", "head_lp", "tail_lp", "lwidth", "lheight", "rects", "vertices",
+	"xdotversion", "_draw_", "_ldraw_", "_hdraw_", "_tdraw_", "_hldraw_", "_tldraw_" };
+
+void add_subgraphs(Agraph_t* graph, std::vector<void*>& objects)
+{
+	objects.push_back(graph);
+	for (Agraph_t* sub = agfstsubg(graph); sub; sub = agnxtsubg(sub))
+		add_subgraphs(sub, objects);
+}
+
+// The caller's values of XDOT_ATTRIBUTES, taken before the render and put
+// back once the page has what it needs. pos, width and height can be layout
+// input. cgraph can't undeclare an attribute, one the render added goes back
+// to "", which Graphviz reads as unset.
+class AttributeSnapshot {
+public:
+	explicit AttributeSnapshot(Agraph_t* graph)
+		: graph_(graph)
+	{
+		add_subgraphs(graph, objects_[AGRAPH]);
+		for (Agnode_t* n = agfstnode(graph); n; n = agnxtnode(graph, n)) {
+			objects_[AGNODE].push_back(n);
+			for (Agedge_t* e = agfstout(graph, n); e; e = agnxtout(graph, e))
+				objects_[AGEDGE].push_back(e);
+		}
+		for (int kind : { AGRAPH, AGNODE, AGEDGE }) {
+			for (const char* name : XDOT_ATTRIBUTES) {
+				Saved saved { kind, name, {} };
+				if (Agsym_t* symbol = agattr(graph, kind, const_cast<char*>(name), nullptr)) {
+					saved.values.reserve(objects_[kind].size());
+					for (void* object : objects_[kind])
+						saved.values.emplace_back(agxget(object, symbol));
+				}
+				saved_.push_back(std::move(saved));
+			}
+		}
+	}
+
+	void restore() const
+	{
+		for (const auto& saved : saved_) {
+			Agsym_t* symbol = agattr(graph_, saved.kind, const_cast<char*>(saved.name), nullptr);
+			if (!symbol)
+				continue;
+			const auto& objects = objects_[saved.kind];
+			for (size_t i = 0; i < objects.size(); ++i)
+				agxset(objects[i], symbol, saved.values.empty() ? "" : saved.values[i].c_str());
+		}
+	}
+
+private:
+	struct Saved {
+		int kind;
+		const char* name;
+		std::vector<std::string> values; // per object, empty if it wasn't declared
+	};
+	Agraph_t* graph_;
+	std::vector<void*> objects_[3]; // by kind: AGRAPH, AGNODE, AGEDGE
+	std::vector<Saved> saved_;
+};
+
+const char* const PAGE_HEAD = R"html(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>)html";
+
+const char* const PAGE_STYLE = R"html(</title>
+<style>
+html,body{margin:0;height:100%;overflow:hidden;font:12px sans-serif}
+canvas{display:block;cursor:grab}
+#bar{position:fixed;top:6px;left:6px;background:#fffe;border:1px solid #bbb;padding:3px 6px;border-radius:3px}
+#tip{position:fixed;display:none;white-space:pre;background:#ffffe8;border:1px solid #999;padding:4px;pointer-events:none}
+</style></head><body>
+<canvas id="view"></canvas>
+<div id="bar"><button id="fit">Fit</button> <button id="all">Expand all</button> <button id="fold">Collapse</button> <span id="info"></span></div>
+<div id="tip"></div>
+<script>
+const G = )html";
+
+// Rows are [x, y, w, h, box, parent, label, fill, tooltip, url]
+const char* const PAGE_SCRIPT = R"html(;
+const X = 0, Y = 1, W = 2, H = 3, BOX = 4, P = 5, LABEL = 6, FILL = 7, TIP = 8, URL = 9;
+const N = G.nodes, E = G.edges, count = N.length, BUDGET = 2000, CELL = 256;
+const kids = N.map(() => []);
+N.forEach((n, i) => { if (n[P] >= 0) kids[n[P]].push(i); });
+const open = new Uint8Array(count), shown = new Uint8Array(count);
+const canvas = document.getElementById('view'), ctx = canvas.getContext('2d');
+const tip = document.getElementById('tip'), info = document.getElementById('info');
+
+// uniform grid over the layout, painting and picking only look at the cells on screen
+const grid = new Map();
+let reach = 0;
+N.forEach((n, i) => {
+	const key = Math.floor(n[X] / CELL) + ',' + Math.floor(n[Y] / CELL);
+	if (!grid.has(key)) grid.set(key, []);
+	grid.get(key).push(i);
+	reach = Math.max(reach, n[W] / 2, n[H] / 2);
+});
+function inView(x0, y0, x1, y1, fn) {
+	for (let cx = Math.floor((x0 - reach) / CELL); cx <= Math.floor((x1 + reach) / CELL); cx++)
+		for (let cy = Math.floor((y0 - reach) / CELL); cy <= Math.floor((y1 + reach) / CELL); cy++) {
+			const cell = grid.get(cx + ',' + cy);
+			if (cell) for (const i of cell) if (shown[i]) fn(i);
+		}
+}
+
+// open whole levels from the roots while they fit the budget
+function collapse() {
+	open.fill(0);
+	let level = [];
+	for (let i = 0; i < count; i++) if (N[i][P] < 0) level.push(i);
+	let total = level.length;
+	while (level.length) {
+		const next = [];
+		for (const i of level) for (const k of kids[i]) next.push(k);
+		if (!next.length || total + next.length > BUDGET) break;
+		for (const i of level) open[i] = 1;
+		total += next.length;
+		level = next;
+	}
+	refresh();
+}
+function refresh() {
+	shown.fill(0);
+	const stack = [];
+	for (let i = 0; i < count; i++) if (N[i][P] < 0) { shown[i] = 1; stack.push(i); }
+	let visible = stack.length;
+	while (stack.length) {
+		const i = stack.pop();
+		if (open[i]) for (const k of kids[i]) { shown[k] = 1; stack.push(k); visible++; }
+	}
+	info.textContent = visible + ' of ' + count + ' nodes, click to expand or collapse, wheel to zoom, drag to pan';
+	redraw();
+}
+
+let scale = 1, ox = 0, oy = 0, queued = false, dpr = 1;
+function fit() {
+	scale = Math.min(canvas.clientWidth / G.width, canvas.clientHeight / G.height) * 0.95 || 1;
+	ox = (G.width - canvas.clientWidth / scale) / 2;
+	oy = (G.height - canvas.clientHeight / scale) / 2;
+	redraw();
+}
+function redraw() {
+	if (!queued) { queued = true; requestAnimationFrame(draw); }
+}
+function draw() {
+	queued = false;
+	const cw = canvas.clientWidth, ch = canvas.clientHeight;
+	ctx.setTransform(dpr, 0, 0, dpr, 0, 0);
+	ctx.clearRect(0, 0, cw, ch);
+	ctx.setTransform(dpr * scale, 0, 0, dpr * scale, -ox * scale * dpr, -oy * scale * dpr);
+	const x0 = ox, y0 = oy, x1 = ox + cw / scale, y1 = oy + ch / scale;
+
+	ctx.beginPath();
+	for (let e = 0; e < E.length; e += 2) {
+		const a = E[e], b = E[e + 1];
+		if (!shown[a] || !shown[b]) continue;
+		const ax = N[a][X], ay = N[a][Y], bx = N[b][X], by = N[b][Y];
+		if (Math.max(ax, bx) < x0 || Math.min(ax, bx) > x1 || Math.max(ay, by) < y0 || Math.min(ay, by) > y1) continue;
+		ctx.moveTo(ax, ay);
+		ctx.lineTo(bx, by);
+	}
+	ctx.lineWidth = 1 / scale;
+	ctx.strokeStyle = '#888';
+	ctx.stroke();
+
+	const labels = scale * 12 >= 7; // skip text too small to read
+	ctx.font = '12px sans-serif';
+	ctx.textAlign = 'center';
+	ctx.textBaseline = 'middle';
+	inView(x0, y0, x1, y1, i => {
+		const n = N[i], w = n[W], h = n[H];
+		if (n[X] + w / 2 < x0 || n[X] - w / 2 > x1 || n[Y] + h / 2 < y0 || n[Y] - h / 2 > y1) return;
+		ctx.beginPath();
+		if (n[BOX]) ctx.rect(n[X] - w / 2, n[Y] - h / 2, w, h);
+		else ctx.ellipse(n[X], n[Y], w / 2, h / 2, 0, 0, 2 * Math.PI);
+		ctx.fillStyle = n[FILL] || '#fff';
+		ctx.fill();
+		const folded = !open[i] && kids[i].length;
+		ctx.lineWidth = (folded ? 3 : 1) / scale;
+		ctx.strokeStyle = folded ? '#333' : '#666';
+		ctx.stroke();
+		if (!labels) return;
+		ctx.fillStyle = '#000';
+		const lines = n[LABEL].split('\n');
+		if (folded) lines.push('+' + kids[i].length);
+		lines.forEach((line, l) => ctx.fillText(line, n[X], n[Y] + (l - (lines.length - 1) / 2) * 13));
+	});
+}
+
+function pick(mx, my) {
+	const x = ox + mx / scale, y = oy + my / scale;
+	let hit = -1;
+	inView(x, y, x, y, i => {
+		const n = N[i];
+		if (Math.abs(x - n[X]) <= n[W] / 2 && Math.abs(y - n[Y]) <= n[H] / 2) hit = i;
+	});
+	return hit;
+}
+
+function resize() {
+	dpr = window.devicePixelRatio || 1;
+	canvas.width = window.innerWidth * dpr;
+	canvas.height = window.innerHeight * dpr;
+	canvas.style.width = window.innerWidth + 'px';
+	canvas.style.height = window.innerHeight + 'px';
+	redraw();
+}
+let drag = null;
+canvas.addEventListener('mousedown', e => { drag = { x: e.clientX, y: e.clientY, moved: false }; });
+window.addEventListener('mouseup', e => {
+	if (drag && !drag.moved) {
+		const i = pick(e.clientX, e.clientY);
+		if (i >= 0 && kids[i].length) { open[i] ^= 1; refresh(); }
+		else if (i >= 0 && N[i][URL]) window.location.href = N[i][URL];
+	}
+	drag = null;
+});
+canvas.addEventListener('mousemove', e => {
+	if (drag) {
+		const dx = e.clientX - drag.x, dy = e.clientY - drag.y;
+		if (Math.abs(dx) + Math.abs(dy) > 3) drag.moved = true;
+		if (drag.moved) {
+			ox -= dx / scale; oy -= dy / scale;
+			drag.x = e.clientX; drag.y = e.clientY;
+			redraw();
+		}
+		tip.style.display = 'none';
+		return;
+	}
+	const i = pick(e.clientX, e.clientY);
+	if (i < 0 || !N[i][TIP]) { tip.style.display = 'none'; return; }
+	tip.textContent = N[i][TIP];
+	tip.style.left = e.clientX + 12 + 'px';
+	tip.style.top = e.clientY + 12 + 'px';
+	tip.style.display = 'block';
+});
+canvas.addEventListener('wheel', e => {
+	e.preventDefault();
+	const factor = Math.exp(-e.deltaY * 0.002);
+	const x = ox + e.clientX / scale, y = oy + e.clientY / scale;
+	scale *= factor;
+	ox = x - e.clientX / scale; oy = y - e.clientY / scale;
+	redraw();
+}, { passive: false });
+window.addEventListener('resize', resize);
+document.getElementById('fit').onclick = fit;
+document.getElementById('all').onclick = () => { open.fill(1); refresh(); };
+document.getElementById('fold').onclick = collapse;
+resize();
+collapse();
+fit();
+</script></body></html>
+)html";
+} // namespace
+
+bool render_html(GVC_t* gvc, Agraph_t* graph, std::string& out)
+{
+	// xdot writes pos, width, height and the draw ops back onto the graph,
+	// read them from there and leave the graph as it came
+	const AttributeSnapshot caller(graph);
+	std::string xdot;
+	if (!render_data(gvc, graph, "xdot", xdot)) {
+		caller.restore();
+		return false;
+	}
+
+	double llx = 0.0, lly = 0.0, urx = 0.0, ury = 0.0;
+	std::sscanf(attribute(graph, "bb"), "%lf,%lf,%lf,%lf", &llx, &lly, &urx, &ury);
+
+	std::vector<HtmlNode> nodes;
+	std::unordered_map<Agnode_t*, long> index;
+	for (Agnode_t* n = agfstnode(graph); n; n = agnxtnode(graph, n)) {
+		HtmlNode node;
+		const std::string name = agnameof(n);
+		double x = 0.0, y = 0.0;
+		std::sscanf(attribute(n, "pos"), "%lf,%lf", &x, &y);
+		node.x = x - llx;
+		node.y = ury - y; // Graphviz has y going up
+		node.width = std::atof(attribute(n, "width")) * 72.0;
+		node.height = std::atof(attribute(n, "height")) * 72.0;
+		node.box = is_box(attribute(n, "shape"));
+		char* label = agget(n, const_cast<char*>("label"));
+		node.label = !label || !*label || aghtmlstr(label) ? name : unescape(label, name);
+		node.fill = xdot_fill(attribute(n, "_draw_"));
+		node.tooltip = unescape(attribute(n, "tooltip"), name);
+		node.url = attribute(n, "URL");
+		if (node.url.empty())
+			node.url = attribute(n, "href");
+		index.emplace(n, static_cast<long>(nodes.size()));
+		nodes.push_back(std::move(node));
+	}
+
+	std::vector<long> edges;
+	for (Agnode_t* n = agfstnode(graph); n; n = agnxtnode(graph, n)) {
+		const long head = index.at(n);
+		for (Agedge_t* e = agfstin(graph, n); e; e = agnxtin(graph, e)) {
+			const long tail = index.at(agtail(e));
+			edges.push_back(tail);
+			edges.push_back(head);
+			if (nodes[head].parent < 0 && tail != head && std::strcmp(attribute(e, "constraint"), "false") != 0)
+				nodes[head].parent = tail;
+		}
+	}
+	caller.restore();
+	break_cycles(nodes);
+
+	std::ostringstream page;
+	page << PAGE_HEAD << html_escape(agnameof(graph)) << PAGE_STYLE;
+	char number[32];
+	auto put = [&](double value) {
+		std::snprintf(number, sizeof(number), "%.1f", value);
+		page << number;
+	};
+	page << "{\"width\":";
+	put(urx - llx);
+	page << ",\"height\":";
+	put(ury - lly);
+	page << ",\"nodes\":[";
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const auto& node = nodes[i];
+		page << (i ? ",\n[" : "\n[");
+		put(node.x);
+		page << ',';
+		put(node.y);
+		page << ',';
+		put(node.width);
+		page << ',';
+		put(node.height);
+		page << ',' << (node.box ? 1 : 0) << ',' << node.parent << ',';
+		json_string(page, node.label);
+		page << ',';
+		json_string(page, node.fill);
+		page << ',';
+		json_string(page, node.tooltip);
+		page << ',';
+		json_string(page, node.url);
+		page << ']';
+	}
+	page << "],\n\"edges\":[";
+	for (size_t i = 0; i < edges.size(); ++i)
+		page << (i ? "," : "") << edges[i];
+	page << "]}" << PAGE_SCRIPT;
+	out = page.str();
+	return true;
+}
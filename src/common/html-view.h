@@ -0,0 +1,16 @@
+#ifndef COMMON_HTML_VIEW_H
+#define COMMON_HTML_VIEW_H
+#include <graphviz/gvc.h>
+#include <string>
+
+// Output format produced here rather than by a Graphviz plugin
+constexpr const char* HTML_FORMAT = "html";
+
+// A laid out graph as one self-contained HTML page. Positions, sizes,
+// colours and tooltips go into a JSON node table, drawn on a canvas that
+// only paints the nodes on screen. Subtrees below what fits a first screen
+// start collapsed and open on click, nodes with a URL link out.
+// graph keeps its attributes, other formats can be rendered from it after.
+// False if Graphviz failed.
+bool render_html(GVC_t* gvc, Agraph_t* graph, std::string& out);
+#endif // COMMON_HTML_VIEW_H
@@ -0,0 +1,316 @@
+#include "common/layout.h"
+#include "common/output.h"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+constexpr const char* TREE_ENGINE = "tree";
+
+// cheaper engines come later, anything not listed counts as the most expensive
+int cost_rank(const std::string& engine)
+{
+	if (engine == "sfdp")
+		return 1;
+	if (engine == "dot")
+		return 2;
+	if (engine == TREE_ENGINE)
+		return 3;
+	return 0;
+}
+
+std::vector<std::string> fallback_chain(const std::string& engine)
+{
+	std::vector<std::string> chain { engine };
+	for (const char* cheaper : { "sfdp", "dot", TREE_ENGINE })
+		if (cost_rank(cheaper) > cost_rank(engine))
+			chain.push_back(cheaper);
+	return chain;
+}
+
+// outs[i] for formats[i], all from one layout
+bool layout_in_process(GVC_t* gvc, Agraph_t* graph, const std::string& engine, const std::vector<std::string>& formats, std::vector<std::string>& outs)
+{
+	if (gvLayout(gvc, graph, engine.c_str()) != 0)
+		return false;
+	outs.resize(formats.size());
+	bool ok = true;
+	for (size_t i = 0; ok && i < formats.size(); ++i)
+		ok = render_data(gvc, graph, formats[i], outs[i]);
+	gvFreeLayout(gvc, graph);
+	return ok;
+}
+
+bool write_all(int fd, const char* data, size_t size)
+{
+	while (size > 0) {
+		const ssize_t written = write(fd, data, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+enum class Outcome {
+	Done,
+	Failed,
+	TimedOut
+};
+
+// Graphviz can't be interrupted, so the layout runs in a child that gets
+// killed when the time is up. The child renders and pipes the bytes back,
+// every format behind its length.
+Outcome layout_in_worker(GVC_t* gvc, Agraph_t* graph, const std::string& engine, const std::vector<std::string>& formats, unsigned timeout_ms, std::vector<std::string>& outs)
+{
+	int pipe_fd[2];
+	if (pipe(pipe_fd) != 0)
+		return Outcome::Failed;
+	std::fflush(nullptr);
+	const pid_t pid = fork();
+	if (pid < 0) {
+		close(pipe_fd[0]);
+		close(pipe_fd[1]);
+		return Outcome::Failed;
+	}
+	if (pid == 0) {
+		close(pipe_fd[0]);
+		std::vector<std::string> rendered;
+		if (!layout_in_process(gvc, graph, engine, formats, rendered))
+			_exit(1);
+		for (const auto& data : rendered) {
+			const uint64_t size = data.size();
+			if (!write_all(pipe_fd[1], reinterpret_cast<const char*>(&size), sizeof(size)) || !write_all(pipe_fd[1], data.data(), data.size()))
+				_exit(1);
+		}
+		_exit(0);
+	}
+
+	close(pipe_fd[1]);
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	Outcome outcome = Outcome::Done;
+	std::string received;
+	char buffer[65536];
+	for (;;) {
+		const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if (left <= 0) {
+			outcome = Outcome::TimedOut;
+			break;
+		}
+		struct pollfd pfd = { pipe_fd[0], POLLIN, 0 };
+		const int ready = poll(&pfd, 1, static_cast<int>(left));
+		if (ready < 0 && errno == EINTR)
+			continue;
+		if (ready == 0)
+			continue; // deadline check above
+		const ssize_t got = read(pipe_fd[0], buffer, sizeof(buffer));
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			break; // EOF, the child is done one way or another
+		received.append(buffer, static_cast<size_t>(got));
+	}
+	close(pipe_fd[0]);
+
+	if (outcome == Outcome::TimedOut)
+		kill(pid, SIGKILL);
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+	if (outcome == Outcome::TimedOut)
+		return outcome;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return Outcome::Failed;
+	outs.assign(formats.size(), std::string());
+	size_t offset = 0;
+	for (auto& out : outs) {
+		uint64_t size = 0;
+		if (received.size() - offset < sizeof(size))
+			return Outcome::Failed;
+		std::memcpy(&size, received.data() + offset, sizeof(size));
+		offset += sizeof(size);
+		if (received.size() - offset < size)
+			return Outcome::Failed;
+		out.assign(received, offset, static_cast<size_t>(size));
+		offset += static_cast<size_t>(size);
+	}
+	return Outcome::Done;
+}
+
+// Layered tree: depth sets y, leaves take the next free x slot and parents
+// centre over their children. Cycles and cross edges are ignored, every node
+// is placed once. Linear time, the last resort for graphs nothing else can do.
+bool tree_layout(GVC_t* gvc, Agraph_t* graph, const std::vector<std::string>& formats, std::vector<std::string>& outs)
+{
+	constexpr double x_step = 110.0; // points
+	constexpr double y_step = 90.0;
+
+	std::vector<Agnode_t*> nodes;
+	std::unordered_map<Agnode_t*, size_t> index;
+	for (Agnode_t* n = agfstnode(graph); n; n = agnxtnode(graph, n)) {
+		index.emplace(n, nodes.size());
+		nodes.push_back(n);
+	}
+	std::vector<std::vector<size_t>> children(nodes.size());
+	std::vector<char> has_parent(nodes.size(), 0);
+	for (size_t i = 0; i < nodes.size(); ++i)
+		for (Agedge_t* e = agfstout(graph, nodes[i]); e; e = agnxtout(graph, e)) {
+			const size_t child = index.at(aghead(e));
+			children[i].push_back(child);
+			has_parent[child] = 1;
+		}
+
+	// roots first, then whatever only hangs off a cycle
+	std::vector<size_t> roots;
+	for (size_t i = 0; i < nodes.size(); ++i)
+		if (!has_parent[i])
+			roots.push_back(i);
+	for (size_t i = 0; i < nodes.size(); ++i)
+		if (has_parent[i])
+			roots.push_back(i);
+
+	std::vector<char> placed(nodes.size(), 0);
+	std::vector<double> x(nodes.size(), 0.0), y(nodes.size(), 0.0);
+	double next_slot = 0.0;
+	for (size_t root : roots) {
+		if (placed[root])
+			continue;
+		// iterative post-order, x of a parent needs its children first
+		struct Frame {
+			size_t node;
+			size_t depth;
+			size_t next_child;
+			double first_x, last_x;
+			bool any_child;
+		};
+		std::vector<Frame> stack { { root, 0, 0, 0.0, 0.0, false } };
+		placed[root] = 1;
+		while (!stack.empty()) {
+			Frame& frame = stack.back();
+			if (frame.next_child < children[frame.node].size()) {
+				const size_t child = children[frame.node][frame.next_child++];
+				if (!placed[child]) {
+					placed[child] = 1;
+					const size_t depth = frame.depth + 1;
+					stack.push_back({ child, depth, 0, 0.0, 0.0, false });
+				}
+				continue;
+			}
+			const size_t node = frame.node;
+			x[node] = frame.any_child ? (frame.first_x + frame.last_x) / 2.0 : (next_slot++) * x_step;
+			y[node] = -static_cast<double>(frame.depth) * y_step;
+			stack.pop_back();
+			if (!stack.empty()) {
+				Frame& parent = stack.back();
+				if (!parent.any_child)
+					parent.first_x = x[node];
+				parent.last_x = x[node];
+				parent.any_child = true;
+			}
+		}
+	}
+
+	char pos[64];
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		std::snprintf(pos, sizeof(pos), "%.1f,%.1f!", x[i], y[i]);
+		agsafeset(nodes[i], const_cast<char*>("pos"), pos, const_cast<char*>(""));
+	}
+	return layout_in_process(gvc, graph, "nop", formats, outs);
+}
+} // namespace
+
+bool known_engine(const std::string& engine)
+{
+	for (const char* known : { "dot", "fdp", "sfdp", "neato", "circo", "twopi", "auto" })
+		if (engine == known)
+			return true;
+	return false;
+}
+
+std::string auto_engine(size_t nodes, size_t edges)
+{
+	if (nodes <= 300)
+		return "fdp";
+	// dot's ranking is quick on trees and close relatives, not on dense graphs
+	if (nodes <= 5000 && edges <= nodes * 2)
+		return "dot";
+	return "sfdp";
+}
+
+bool parse_layout_timeout(const char* text, unsigned& ms)
+{
+	if (!text)
+		return false;
+	char* end = nullptr;
+	const double seconds = std::strtod(text, &end);
+	if (end == text || *end != '\0' || !(seconds > 0.0)) // !(>) catches NaN
+		return false;
+	const double milliseconds = std::ceil(seconds * 1000.0);
+	if (milliseconds > static_cast<double>(UINT_MAX))
+		return false;
+	ms = static_cast<unsigned>(milliseconds);
+	return true;
+}
+
+std::string describe(const LayoutReport& report)
+{
+	char seconds[32];
+	std::snprintf(seconds, sizeof(seconds), "%.2fs", report.seconds);
+	std::string text = "with " + report.engine + " in " + seconds;
+	if (!report.abandoned.empty()) {
+		text += " (";
+		for (size_t i = 0; i < report.abandoned.size(); ++i)
+			text += (i ? ", " : "") + report.abandoned[i];
+		text += ")";
+	}
+	return text;
+}
+
+bool layout_render(GVC_t* gvc, Agraph_t* graph, const std::string& format, const LayoutOptions& options, std::string& out, LayoutReport& report)
+{
+	std::vector<std::string> outs;
+	if (!layout_render(gvc, graph, { format }, options, outs, report))
+		return false;
+	out.swap(outs[0]);
+	return true;
+}
+
+bool layout_render(GVC_t* gvc, Agraph_t* graph, const std::vector<std::string>& formats, const LayoutOptions& options, std::vector<std::string>& outs, LayoutReport& report)
+{
+	const auto started = std::chrono::steady_clock::now();
+	std::string engine = options.engine;
+	if (engine == "auto")
+		engine = auto_engine(static_cast<size_t>(agnnodes(graph)), static_cast<size_t>(agnedges(graph)));
+
+	bool ok = false;
+	for (const auto& attempt : fallback_chain(engine)) {
+		Outcome outcome;
+		if (attempt == TREE_ENGINE)
+			outcome = tree_layout(gvc, graph, formats, outs) ? Outcome::Done : Outcome::Failed;
+		else if (options.timeout_ms == 0)
+			outcome = layout_in_process(gvc, graph, attempt, formats, outs) ? Outcome::Done : Outcome::Failed;
+		else
+			outcome = layout_in_worker(gvc, graph, attempt, formats, options.timeout_ms, outs);
+		if (outcome == Outcome::Done) {
+			report.engine = attempt;
+			ok = true;
+			break;
+		}
+		report.abandoned.push_back(attempt + (outcome == Outcome::TimedOut ? " timed out" : " failed"));
+	}
+	report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	return ok;
+}
@@ -0,0 +1,42 @@
+#ifndef COMMON_LAYOUT_H
+#define COMMON_LAYOUT_H
+#include <cstddef>
+#include <graphviz/gvc.h>
+#include <string>
+#include <vector>
+
+// The engines both tools offer: dot, fdp, sfdp, neato, circo, twopi and auto
+bool known_engine(const std::string& engine);
+
+// Engine that lays a graph out in reasonable time given its size:
+// fdp for small graphs, dot for tree-like ones, sfdp for the rest
+std::string auto_engine(size_t nodes, size_t edges);
+
+struct LayoutOptions {
+	std::string engine = "fdp"; // any Graphviz engine, or "auto"
+	unsigned timeout_ms = 0; // per attempt, 0: no budget, lay out in process
+};
+
+struct LayoutReport {
+	std::string engine; // the one that produced the output, "tree" for the built-in layout
+	double seconds = 0.0; // all attempts together
+	std::vector<std::string> abandoned; // "fdp timed out", "sfdp failed", in order
+};
+
+// --layout-timeout: seconds above 0, to whole ms rounded up so a tiny budget
+// doesn't become 0 (no budget). False if it's not a number or the ms don't
+// fit in an unsigned.
+bool parse_layout_timeout(const char* text, unsigned& ms);
+
+// "with sfdp in 1.2s (fdp timed out)" style summary
+std::string describe(const LayoutReport& report);
+
+// Lay out and render `graph` as format. With a timeout every attempt runs in
+// a forked worker that is killed once over budget. A timed out or failed
+// engine falls back to the next cheaper one, sfdp, then dot, then a plain
+// tree layout computed here and drawn with "nop", which always finishes.
+// The graph is left without a layout.
+bool layout_render(GVC_t* gvc, Agraph_t* graph, const std::string& format, const LayoutOptions& options, std::string& out, LayoutReport& report);
+// Same, every format from the one layout, outs[i] for formats[i]
+bool layout_render(GVC_t* gvc, Agraph_t* graph, const std::vector<std::string>& formats, const LayoutOptions& options, std::vector<std::string>& outs, LayoutReport& report);
+#endif // COMMON_LAYOUT_H
@@ -0,0 +1,50 @@
+#include "common/output.h"
+#include "common/html-view.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+std::string output_format(const std::string& output_path, const std::string& format)
+{
+	if (!format.empty())
+		return format;
+	if (output_path != STDIO_PATH) {
+		const std::string extension = std::filesystem::path(output_path).extension().string();
+		if (extension.size() > 1)
+			return extension.substr(1);
+	}
+	return "svg";
+}
+
+bool render_data(GVC_t* gvc, Agraph_t* graph, const std::string& format, std::string& out)
+{
+	if (format == HTML_FORMAT)
+		return render_html(gvc, graph, out);
+	char* data = nullptr;
+	unsigned int length = 0;
+	if (gvRenderData(gvc, graph, format.c_str(), &data, &length) != 0)
+		return false;
+	out.assign(data, length);
+	gvFreeRenderData(data);
+	return true;
+}
+
+bool write_output(const std::string& data, const std::string& output_path)
+{
+	if (output_path == STDIO_PATH) {
+		std::cout.write(data.data(), static_cast<std::streamsize>(data.size()));
+		std::cout.flush();
+		return static_cast<bool>(std::cout);
+	}
+	std::ofstream file(output_path, std::ios::binary | std::ios::trunc);
+	file.write(data.data(), static_cast<std::streamsize>(data.size()));
+	return static_cast<bool>(file);
+}
+
+bool render_output(GVC_t* gvc, Agraph_t* graph, const std::string& format, const std::string& output_path)
+{
+	if (output_path != STDIO_PATH && format != HTML_FORMAT)
+		return gvRenderFilename(gvc, graph, format.c_str(), output_path.c_str()) == 0;
+	std::string data;
+	return render_data(gvc, graph, format, data) && write_output(data, output_path);
+}
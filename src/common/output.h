@@ -0,0 +1,23 @@
+#ifndef COMMON_OUTPUT_H
+#define COMMON_OUTPUT_H
+#include <graphviz/gvc.h>
+#include <string>
+
+// "-" as a file name: stdin for inputs, stdout for outputs
+constexpr const char* STDIO_PATH = "-";
+
+// Explicit format if there is one, else the output file's extension, else svg
+std::string output_format(const std::string& output_path, const std::string& format = "");
+
+// Render a laid out graph into memory, false if Graphviz failed. Knows
+// "html" on top of the Graphviz formats, see render_html().
+bool render_data(GVC_t* gvc, Agraph_t* graph, const std::string& format, std::string& out);
+
+// Already rendered bytes to output_path, or to stdout for "-"
+bool write_output(const std::string& data, const std::string& output_path);
+
+// Render a laid out graph to output_path, or to stdout for "-". Stdout gets
+// the whole render in one buffered write, so nothing else may print there.
+// Returns false if Graphviz failed.
+bool render_output(GVC_t* gvc, Agraph_t* graph, const std::string& format, const std::string& output_path);
+#endif // COMMON_OUTPUT_H
@@ -0,0 +1,40 @@
+#ifndef COMMON_PARALLEL_FOR_H
+#define COMMON_PARALLEL_FOR_H
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Run fn(i) for every i in [0, count) on up to `workers` threads, 0 means one
+// per core. Indices are handed out in small chunks, so uneven per-item cost
+// (a process with a huge page table, a daemon with 100k fds) balances out.
+// fn must not throw.
+template <typename Fn>
+void parallel_for(size_t count, unsigned workers, Fn&& fn)
+{
+	if (workers == 0)
+		workers = std::max(1u, std::thread::hardware_concurrency());
+	constexpr size_t chunk = 16;
+	const size_t threads = std::min<size_t>(workers, (count + chunk - 1) / chunk);
+	if (threads <= 1) {
+		for (size_t i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+
+	std::atomic<size_t> next { 0 };
+	auto worker = [&] {
+		for (size_t begin; (begin = next.fetch_add(chunk)) < count;)
+			for (size_t i = begin; i < std::min(begin + chunk, count); ++i)
+				fn(i);
+	};
+	std::vector<std::thread> pool;
+	pool.reserve(threads - 1);
+	for (size_t t = 1; t < threads; ++t)
+		pool.emplace_back(worker);
+	worker(); // the calling thread pulls its weight too
+	for (auto& thread : pool)
+		thread.join();
+}
+#endif // COMMON_PARALLEL_FOR_H
@@ -0,0 +1,224 @@
+#include "common/render-cache.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr uint64_t K1 = 0x87c37b91114253d5ULL;
+constexpr uint64_t K2 = 0x4cf5ad432745937fULL;
+
+uint64_t rotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+// murmur3's finaliser
+uint64_t fmix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+bool write_all(int fd, const char* data, size_t size)
+{
+	while (size > 0) {
+		const ssize_t written = write(fd, data, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+struct timespec modified(const struct stat& st)
+{
+#if defined(__APPLE__) && defined(__MACH__)
+	return st.st_mtimespec;
+#else
+	return st.st_mtim;
+#endif
+}
+
+// writers that died mid-store leave these behind
+constexpr const char* TMP_PREFIX = ".tmp-";
+constexpr time_t STALE_TMP_SECONDS = 3600;
+} // namespace
+
+void ContentHash::mix(uint64_t word)
+{
+	a_ ^= rotl(word * K1, 31) * K2;
+	a_ = rotl(a_, 27) * 5 + 0x52dce729;
+	b_ += word ^ K2;
+	b_ = rotl(b_, 33) * K1 + a_;
+}
+
+ContentHash& ContentHash::add(const void* data, size_t size)
+{
+	mix(size);
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		mix(word);
+	}
+	if (i < size) {
+		uint64_t word = 0;
+		std::memcpy(&word, bytes + i, size - i);
+		mix(word);
+	}
+	length_ += size;
+	return *this;
+}
+
+std::string ContentHash::hex() const
+{
+	const uint64_t a = fmix(a_ ^ length_);
+	const uint64_t b = fmix(b_ + a);
+	static const char digits[] = "0123456789abcdef";
+	std::string out(32, '0');
+	for (int i = 0; i < 16; ++i) {
+		out[15 - i] = digits[(a >> (4 * i)) & 0xf];
+		out[31 - i] = digits[(b >> (4 * i)) & 0xf];
+	}
+	return out;
+}
+
+bool parse_cache_max_mb(const char* text, uint64_t& mb)
+{
+	if (!text || !std::isdigit(static_cast<unsigned char>(text[0])))
+		return false; // strtoull would take "-1" as a huge size
+	errno = 0;
+	char* end = nullptr;
+	const unsigned long long value = std::strtoull(text, &end, 10);
+	if (errno == ERANGE || *end != '\0' || value > (UINT64_MAX >> 20))
+		return false;
+	mb = value;
+	return true;
+}
+
+RenderCache::RenderCache(const std::string& dir, uint64_t max_bytes)
+	: dir_(dir)
+	, max_bytes_(max_bytes)
+{
+	if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST)
+		std::cerr << "Warning: Cannot create cache dir " << dir_ << ": " << std::strerror(errno) << "\n";
+}
+
+bool RenderCache::load(const std::string& key, std::string& data) const
+{
+	// an entry evicted after open() stays readable until close()
+	const int fd = open((dir_ + "/" + key).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	bool ok = fstat(fd, &st) == 0;
+	if (ok) {
+		data.resize(static_cast<size_t>(st.st_size));
+		size_t done = 0;
+		while (ok && done < data.size()) {
+			const ssize_t got = read(fd, &data[done], data.size() - done);
+			if (got < 0 && errno == EINTR)
+				continue;
+			ok = got > 0;
+			if (ok)
+				done += static_cast<size_t>(got);
+		}
+	}
+	if (ok)
+		futimens(fd, nullptr); // most recently used
+	close(fd);
+	return ok;
+}
+
+void RenderCache::store(const std::string& key, const std::string& data) const
+{
+	std::random_device random;
+	const std::string tmp = dir_ + "/" + TMP_PREFIX + std::to_string(getpid()) + "-" + std::to_string(random());
+	const int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		std::cerr << "Warning: Cannot write to cache dir " << dir_ << ": " << std::strerror(errno) << "\n";
+		return;
+	}
+	const bool ok = write_all(fd, data.data(), data.size());
+	close(fd);
+	// same key means same bytes, losing a rename race to another writer is fine
+	if (!ok || rename(tmp.c_str(), (dir_ + "/" + key).c_str()) != 0) {
+		std::cerr << "Warning: Cannot store cache entry " << key << ": " << std::strerror(errno) << "\n";
+		unlink(tmp.c_str());
+		return;
+	}
+	evict();
+}
+
+void RenderCache::evict() const
+{
+	struct Entry {
+		std::string name;
+		uint64_t size;
+		struct timespec used;
+	};
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+	const time_t now = time(nullptr);
+
+	const int lock = open((dir_ + "/.lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (lock < 0)
+		return;
+	// someone else is already evicting, their pass covers ours
+	if (flock(lock, LOCK_EX | LOCK_NB) != 0) {
+		close(lock);
+		return;
+	}
+
+	DIR* dir = opendir(dir_.c_str());
+	if (dir) {
+		while (const dirent* entry = readdir(dir)) {
+			const std::string name = entry->d_name;
+			struct stat st;
+			if (name == "." || name == ".." || name == ".lock" || stat((dir_ + "/" + name).c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+				continue;
+			if (name.compare(0, std::strlen(TMP_PREFIX), TMP_PREFIX) == 0) {
+				if (now - st.st_mtime > STALE_TMP_SECONDS)
+					unlink((dir_ + "/" + name).c_str());
+				continue;
+			}
+			entries.push_back({ name, static_cast<uint64_t>(st.st_size), modified(st) });
+			total += static_cast<uint64_t>(st.st_size);
+		}
+		closedir(dir);
+	}
+
+	if (total > max_bytes_) {
+		// least recently used first, down to 90% so the next store doesn't evict again
+		std::sort(entries.begin(), entries.end(), [](const Entry& l, const Entry& r) {
+			return l.used.tv_sec != r.used.tv_sec ? l.used.tv_sec < r.used.tv_sec : l.used.tv_nsec < r.used.tv_nsec;
+		});
+		const uint64_t target = max_bytes_ / 10 * 9;
+		for (const auto& entry : entries) {
+			if (total <= target)
+				break;
+			if (unlink((dir_ + "/" + entry.name).c_str()) == 0)
+				total -= entry.size;
+		}
+	}
+	flock(lock, LOCK_UN);
+	close(lock);
+}
@@ -0,0 +1,49 @@
+#ifndef COMMON_RENDER_CACHE_H
+#define COMMON_RENDER_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Bump whenever the tools render the same input differently, old entries
+// then simply stop matching and age out
+constexpr uint32_t RENDER_CACHE_VERSION = 1;
+constexpr uint64_t DEFAULT_CACHE_MAX_MB = 256;
+
+// --cache-max: a whole number of MB small enough that mb << 20 still fits
+// in 64 bits, false for anything else
+bool parse_cache_max_mb(const char* text, uint64_t& mb);
+
+// Fast non-cryptographic 128 bit hash, fed field by field. Every field is
+// length prefixed, so ("ab", "c") and ("a", "bc") differ.
+class ContentHash {
+public:
+	ContentHash& add(const void* data, size_t size);
+	ContentHash& add(const std::string& s) { return add(s.data(), s.size()); }
+	ContentHash& add(uint64_t value) { return add(&value, sizeof(value)); }
+	std::string hex() const;
+
+private:
+	void mix(uint64_t word);
+	uint64_t a_ = 0x9e3779b97f4a7c15ULL;
+	uint64_t b_ = 0xc2b2ae3d27d4eb4fULL;
+	uint64_t length_ = 0;
+};
+
+// Rendered artefacts on disk, one file per key. Writers go through a temp
+// file and rename(), so readers never see half an entry, and a hit bumps the
+// file's mtime for LRU. Eviction runs after a store once the directory grows
+// past max_bytes, under an flock so parallel runs don't evict twice.
+class RenderCache {
+public:
+	RenderCache(const std::string& dir, uint64_t max_bytes = DEFAULT_CACHE_MAX_MB << 20);
+	// Cached bytes for key, false on a miss
+	bool load(const std::string& key, std::string& data) const;
+	// Best effort, a cache that can't be written only warns
+	void store(const std::string& key, const std::string& data) const;
+
+private:
+	void evict() const;
+	std::string dir_;
+	uint64_t max_bytes_;
+};
+#endif // COMMON_RENDER_CACHE_H
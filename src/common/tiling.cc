@@ -0,0 +1,287 @@
+#include "common/tiling.h"
+#include "common/layout.h"
+#include "common/output.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <graphviz/gvc.h>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+bool parse_count(const char* text, size_t& value)
+{
+	if (!text || !std::isdigit(static_cast<unsigned char>(text[0])))
+		return false;
+	errno = 0;
+	char* end = nullptr;
+	const unsigned long long parsed = std::strtoull(text, &end, 10);
+	if (errno == ERANGE || *end != '\0' || parsed > SIZE_MAX)
+		return false;
+	value = static_cast<size_t>(parsed);
+	return true;
+}
+
+std::string escape_quotes(const std::string& s)
+{
+	std::string escaped;
+	escaped.reserve(s.size());
+	for (char c : s) {
+		if (c == '"')
+			escaped += '\\';
+		escaped += c;
+	}
+	if (!escaped.empty() && escaped.back() == '\\')
+		escaped += ' ';
+	return escaped;
+}
+
+namespace {
+std::string base_name(const std::string& path)
+{
+	const size_t slash = path.find_last_of('/');
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+struct RenderJob {
+	std::string dot;
+	std::string output_file;
+};
+
+bool render_job(const RenderJob& job, const TileOptions& options)
+{
+	GVC_t* gvc = gvContext();
+	Agraph_t* g = agmemread(const_cast<char*>(job.dot.c_str()));
+	bool ok = false;
+	LayoutOptions layout;
+	layout.engine = options.engine;
+	layout.timeout_ms = options.timeout_ms;
+	LayoutReport report;
+	std::string rendered;
+	if (!g)
+		std::cerr << "Error: Failed to parse DOT graph for " << job.output_file << std::endl;
+	else if (!layout_render(gvc, g, options.format, layout, rendered, report))
+		std::cerr << "Error: Failed to layout " << job.output_file << std::endl;
+	else {
+		ok = write_output(rendered, job.output_file);
+		if (!ok)
+			std::cerr << "Error: Failed to render " << job.output_file << std::endl;
+		else if (!report.abandoned.empty())
+			std::cerr << "Warning: " << job.output_file << " laid out " << describe(report) << std::endl;
+	}
+	if (g)
+		agclose(g);
+	gvFreeContext(gvc);
+	return ok;
+}
+
+// one process per job, at most `workers` at a time
+bool run_jobs(const std::vector<RenderJob>& jobs, const TileOptions& options)
+{
+	const unsigned workers = options.workers ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+	bool ok = true;
+	size_t next = 0;
+	unsigned running = 0;
+	std::cout.flush(); // children must not flush our buffers a second time
+	while (next < jobs.size() || running > 0) {
+		while (running < workers && next < jobs.size()) {
+			const pid_t pid = fork();
+			if (pid == 0)
+				_exit(render_job(jobs[next], options) ? EXIT_SUCCESS : EXIT_FAILURE);
+			if (pid < 0) // can't fork, do it ourselves
+				ok = render_job(jobs[next], options) && ok;
+			else
+				++running;
+			++next;
+		}
+		if (running == 0)
+			continue;
+		int status = 0;
+		if (wait(&status) < 0)
+			break;
+		--running;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			ok = false;
+	}
+	return ok;
+}
+} // namespace
+
+std::vector<size_t> partition_tree(const std::vector<TreeNode>& nodes, size_t node_budget, size_t& tile_count)
+{
+	const size_t n = nodes.size();
+	node_budget = std::max<size_t>(1, node_budget);
+
+	// children in CSR form
+	std::vector<size_t> child_start(n + 1, 0);
+	for (const auto& node : nodes)
+		if (node.parent >= 0 && static_cast<size_t>(node.parent) < n)
+			++child_start[node.parent + 1];
+	for (size_t i = 0; i < n; ++i)
+		child_start[i + 1] += child_start[i];
+	std::vector<size_t> children(child_start[n]);
+	std::vector<size_t> fill(child_start.begin(), child_start.end() - 1);
+	for (size_t i = 0; i < n; ++i)
+		if (nodes[i].parent >= 0 && static_cast<size_t>(nodes[i].parent) < n)
+			children[fill[nodes[i].parent]++] = i;
+
+	// pre-order, parents before children. Nodes caught in a parent cycle
+	// are never reached from a real root and become roots themselves.
+	std::vector<size_t> order;
+	std::vector<char> is_root(n, 0), visited(n, 0);
+	order.reserve(n);
+	auto walk = [&](size_t root) {
+		std::vector<size_t> stack { root };
+		is_root[root] = 1;
+		visited[root] = 1;
+		while (!stack.empty()) {
+			const size_t v = stack.back();
+			stack.pop_back();
+			order.push_back(v);
+			for (size_t c = child_start[v]; c < child_start[v + 1]; ++c)
+				if (!visited[children[c]]) {
+					visited[children[c]] = 1;
+					stack.push_back(children[c]);
+				}
+		}
+	};
+	for (size_t i = 0; i < n; ++i)
+		if (nodes[i].parent < 0 || static_cast<size_t>(nodes[i].parent) >= n)
+			walk(i);
+	for (size_t i = 0; i < n; ++i)
+		if (!visited[i])
+			walk(i);
+
+	// bottom-up: cut the heaviest children until the rest fits the budget,
+	// cut siblings get packed together so wide fan-outs don't become
+	// hundreds of single node tiles
+	constexpr size_t NO_GROUP = static_cast<size_t>(-1);
+	std::vector<size_t> weight(n, 1);
+	std::vector<size_t> group(n, NO_GROUP);
+	size_t group_count = 0;
+	std::vector<size_t> kids;
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		const size_t v = *it;
+		kids.clear();
+		for (size_t c = child_start[v]; c < child_start[v + 1]; ++c)
+			if (!is_root[children[c]]) {
+				kids.push_back(children[c]);
+				weight[v] += weight[children[c]];
+			}
+		if (weight[v] <= node_budget)
+			continue;
+		std::sort(kids.begin(), kids.end(), [&](size_t a, size_t b) { return weight[a] > weight[b]; });
+		size_t group_fill = node_budget + 1;
+		for (const size_t c : kids) {
+			if (weight[v] <= node_budget)
+				break;
+			if (group_fill + weight[c] > node_budget) {
+				++group_count;
+				group_fill = 0;
+			}
+			group_fill += weight[c];
+			group[c] = group_count - 1;
+			weight[v] -= weight[c];
+		}
+	}
+
+	// top-down: every group of cut subtrees opens a tile, small root trees
+	// share one too
+	std::vector<size_t> tile(n, 0);
+	std::vector<size_t> group_tile(group_count, NO_GROUP);
+	tile_count = 0;
+	size_t root_fill = node_budget + 1;
+	for (const size_t v : order) {
+		if (is_root[v]) {
+			if (root_fill + weight[v] > node_budget) {
+				++tile_count;
+				root_fill = 0;
+			}
+			root_fill += weight[v];
+			tile[v] = tile_count - 1;
+		} else if (group[v] != NO_GROUP) {
+			if (group_tile[group[v]] == NO_GROUP)
+				group_tile[group[v]] = tile_count++;
+			tile[v] = group_tile[group[v]];
+		} else {
+			tile[v] = tile[nodes[v].parent];
+		}
+	}
+	return tile;
+}
+
+bool render_tiled(const std::vector<TreeNode>& nodes, const TileOptions& options)
+{
+	size_t tile_count = 0;
+	const auto tile = partition_tree(nodes, options.node_budget, tile_count);
+	const std::string url_prefix = base_name(options.output_prefix);
+	auto tile_name = [&](size_t t) { return "-tile-" + std::to_string(t) + "." + options.format; };
+
+	std::vector<size_t> tile_size(tile_count, 0);
+	std::vector<long> tile_root(tile_count, -1);
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		++tile_size[tile[i]];
+		if (tile_root[tile[i]] < 0)
+			tile_root[tile[i]] = static_cast<long>(i);
+	}
+
+	std::vector<std::ostringstream> dots(tile_count);
+	std::ostringstream overview;
+	overview << "digraph overview {\n"
+		 << "node [shape=box3d style=filled fillcolor=\"lightgoldenrod1\"];\n";
+	for (size_t t = 0; t < tile_count; ++t) {
+		dots[t] << "digraph tile_" << t << " {\n"
+			<< options.graph_header << "\n";
+		overview << "  \"" << t << "\" [label=\"" << escape_quotes(nodes[tile_root[t]].label) << "\\n" << tile_size[t] << " nodes\" "
+			 << "URL=\"" << url_prefix << tile_name(t) << "\" "
+			 << "tooltip=\"Open tile " << t << "\"];\n";
+	}
+
+	std::set<std::pair<size_t, size_t>> linked; // (parent tile, tile)
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const TreeNode& node = nodes[i];
+		const size_t t = tile[i];
+		dots[t] << "  \"" << escape_quotes(node.id) << "\" [" << node.attributes << "];\n";
+		if (node.parent < 0 || static_cast<size_t>(node.parent) >= nodes.size())
+			continue;
+		const TreeNode& parent = nodes[node.parent];
+		const size_t pt = tile[node.parent];
+		if (pt == t) {
+			dots[t] << "  \"" << escape_quotes(parent.id) << "\" -> \"" << escape_quotes(node.id) << "\";\n";
+			continue;
+		}
+		// collapsed subtree in the parent tile, and a way back up in ours.
+		// A tile can hold several cut siblings, only link it once.
+		if (linked.emplace(pt, t).second) {
+			dots[pt] << "  \"tile:" << t << "\" [label=\"" << escape_quotes(node.label) << "\\n+" << tile_size[t] << " nodes\" "
+				 << "shape=folder style=filled fillcolor=\"lightgoldenrod1\" "
+				 << "URL=\"" << url_prefix << tile_name(t) << "\" tooltip=\"Expand tile " << t << "\"];\n"
+				 << "  \"" << escape_quotes(parent.id) << "\" -> \"tile:" << t << "\" [style=dashed];\n";
+			dots[t] << "  \"up:" << pt << "\" [label=\"" << escape_quotes(parent.label) << "\" "
+				<< "shape=house style=dashed "
+				<< "URL=\"" << url_prefix << tile_name(pt) << "\" tooltip=\"Back to tile " << pt << "\"];\n";
+			overview << "  \"" << pt << "\" -> \"" << t << "\";\n";
+		}
+		dots[t] << "  \"up:" << pt << "\" -> \"" << escape_quotes(node.id) << "\" [style=dashed];\n";
+	}
+	overview << "}\n";
+
+	std::vector<RenderJob> jobs;
+	jobs.reserve(tile_count + 1);
+	for (size_t t = 0; t < tile_count; ++t) {
+		dots[t] << "}\n";
+		jobs.push_back({ dots[t].str(), options.output_prefix + tile_name(t) });
+	}
+	const std::string overview_file = options.output_prefix + "-overview." + options.format;
+	jobs.push_back({ overview.str(), overview_file });
+
+	const bool ok = run_jobs(jobs, options);
+	if (ok)
+		std::cout << "Successfully rendered " << tile_count << " tiles, overview in " << overview_file << std::endl;
+	return ok;
+}
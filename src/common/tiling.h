@@ -0,0 +1,44 @@
+#ifndef COMMON_TILING_H
+#define COMMON_TILING_H
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A tree (or forest) flattened for tiling, in any order
+struct TreeNode {
+	std::string id; // unique DOT node id
+	std::string label; // short name for the overview and collapsed nodes
+	long parent = -1; // index into the node list, -1 for roots
+	std::string attributes; // DOT attribute list, without the brackets
+};
+
+struct TileOptions {
+	size_t node_budget = 2000; // per tile
+	std::string engine = "dot";
+	unsigned timeout_ms = 0; // per tile layout, over it falls back like layout_render()
+	std::string format = "svg";
+	std::string output_prefix = "graph"; // <prefix>-overview.<format>, <prefix>-tile-<n>.<format>
+	std::string graph_header; // extra DOT statements for every tile, e.g. default node styles
+	unsigned workers = 0; // concurrent layouts, 0: one per core
+};
+
+// --tile's node budget and the like: a whole number that fits a size_t,
+// digits only, false for anything else ("12abc", "-1")
+bool parse_count(const char* text, size_t& value);
+
+// s with its quotes escaped for a DOT string, and a space after a trailing
+// backslash so it can't escape the closing quote
+std::string escape_quotes(const std::string& s);
+
+// Tiles holding no more than node_budget nodes each. Subtrees that don't fit
+// get cut off into their own tile and collapse into a link in their parent
+// tile, small root trees are packed together.
+// Returns the tile index of every node.
+std::vector<size_t> partition_tree(const std::vector<TreeNode>& nodes, size_t node_budget, size_t& tile_count);
+
+// Partition, lay out and render every tile in parallel, each in a worker
+// process with its own GVC context (Graphviz keeps global state, so threads
+// can't share it), then render a small overview whose nodes link to the
+// tiles. Returns false if any tile failed.
+bool render_tiled(const std::vector<TreeNode>& nodes, const TileOptions& options);
+#endif // COMMON_TILING_H
@@ -0,0 +1,298 @@
+#include "dt2gv/address-map.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <unordered_set>
+
+// Until a node says otherwise, per the devicetree spec
+static constexpr unsigned DEFAULT_ADDRESS_CELLS = 2;
+static constexpr unsigned DEFAULT_SIZE_CELLS = 1;
+
+uint64_t AddressWindow::end() const
+{
+	return base + size < base ? UINT64_MAX : base + size;
+}
+
+namespace {
+// child bus [child, child + size) shows up at [cpu, cpu + size)
+struct Range {
+	uint64_t child;
+	uint64_t cpu;
+	uint64_t size;
+};
+
+struct Translation {
+	bool identity = false; // the root bus, or only empty ranges up to it
+	std::vector<Range> ranges;
+};
+
+// The bus a node sits on, as its parent describes it
+struct Bus {
+	unsigned address_cells = DEFAULT_ADDRESS_CELLS;
+	unsigned size_cells = DEFAULT_SIZE_CELLS;
+	long translation = 0; // index into the translations, -1: not CPU addressable
+};
+
+uint32_t read_u32(const std::string& value, size_t offset)
+{
+	const auto* bytes = reinterpret_cast<const unsigned char*>(value.data() + offset);
+	return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 | uint32_t(bytes[2]) << 8 | bytes[3];
+}
+
+// Big endian cells, only the low 64 bits survive: PCI's 3 cell addresses
+// keep their flags in the top cell
+uint64_t read_cells(const std::string& value, size_t& offset, unsigned cells)
+{
+	uint64_t result = 0;
+	for (unsigned i = 0; i < cells; ++i, offset += 4)
+		result = result << 32 | read_u32(value, offset);
+	return result;
+}
+
+unsigned cell_count(const Device_Tree_Node_t* node, const char* property, unsigned fallback)
+{
+	const auto it = node->properties.find(property);
+	return it != node->properties.end() && it->second.size() >= 4 ? read_u32(it->second, 0) : fallback;
+}
+
+// Map addr through one bus, clamping size to the range it falls into
+bool translate(const Translation& translation, uint64_t addr, uint64_t& size, uint64_t& cpu)
+{
+	if (translation.identity) {
+		cpu = addr;
+		return true;
+	}
+	for (const auto& range : translation.ranges) {
+		if (addr < range.child || addr - range.child >= range.size)
+			continue;
+		cpu = range.cpu + (addr - range.child);
+		size = std::min(size, range.size - (addr - range.child));
+		return true;
+	}
+	return false;
+}
+
+bool is_ancestor(const std::string& ancestor, const std::string& path)
+{
+	return ancestor == "/" ? path != "/" : path.size() > ancestor.size() && path.compare(0, ancestor.size(), ancestor) == 0 && path[ancestor.size()] == '/';
+}
+
+// /reserved-memory children mark parts of RAM, they sit inside a memory
+// node's window by design
+bool reserves(const AddressWindow& reservation, const AddressWindow& other)
+{
+	return other.memory && is_ancestor("/reserved-memory", reservation.path);
+}
+
+bool is_memory(const Device_Tree_Node_t* node)
+{
+	const auto it = node->properties.find("device_type");
+	return it != node->properties.end() && std::strcmp(it->second.c_str(), "memory") == 0;
+}
+
+std::string hex(uint64_t value)
+{
+	char buffer[19];
+	std::snprintf(buffer, sizeof(buffer), "0x%016llx", static_cast<unsigned long long>(value));
+	return buffer;
+}
+
+std::string human_size(uint64_t size)
+{
+	static const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB" };
+	size_t unit = 0;
+	while (unit + 1 < std::size(units) && size >= 1024 && size % 1024 == 0) {
+		size /= 1024;
+		++unit;
+	}
+	return std::to_string(size) + " " + units[unit];
+}
+
+std::string window_name(const AddressWindow& window)
+{
+	return window.reg_index ? window.path + " reg[" + std::to_string(window.reg_index) + "]" : window.path;
+}
+
+std::string json_string(const std::string& s)
+{
+	std::string quoted = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+} // namespace
+
+AddressMap build_address_map(Device_Tree_Node_t* root)
+{
+	AddressMap map;
+	std::vector<Translation> translations(1);
+	translations[0].identity = true;
+
+	struct Pending {
+		Device_Tree_Node_t* node;
+		std::string path;
+		Bus bus;
+	};
+	std::vector<Pending> stack;
+	if (root)
+		stack.push_back({ root, "/", Bus {} });
+	while (!stack.empty()) {
+		Pending pending = std::move(stack.back());
+		stack.pop_back();
+		const Device_Tree_Node_t* node = pending.node;
+		const Bus& bus = pending.bus;
+
+		// this node's windows, in its parent's address space
+		const auto reg = node->properties.find("reg");
+		const size_t reg_stride = (size_t(bus.address_cells) + bus.size_cells) * 4;
+		if (reg != node->properties.end() && reg_stride > 0 && bus.size_cells > 0) {
+			const bool memory = is_memory(node);
+			size_t offset = 0;
+			for (size_t index = 0; offset + reg_stride <= reg->second.size(); ++index) {
+				const uint64_t addr = read_cells(reg->second, offset, bus.address_cells);
+				uint64_t size = read_cells(reg->second, offset, bus.size_cells);
+				uint64_t cpu = 0;
+				if (size == 0)
+					continue;
+				if (bus.translation < 0 || !translate(translations[bus.translation], addr, size, cpu)) {
+					++map.untranslated;
+					continue;
+				}
+				map.windows.push_back({ pending.path, index, cpu, size, memory });
+			}
+		}
+
+		// the bus this node provides to its children
+		Bus child_bus;
+		child_bus.address_cells = cell_count(node, "#address-cells", DEFAULT_ADDRESS_CELLS);
+		child_bus.size_cells = cell_count(node, "#size-cells", DEFAULT_SIZE_CELLS);
+		const auto ranges = node->properties.find("ranges");
+		if (node == root) {
+			child_bus.translation = 0;
+		} else if (bus.translation < 0 || ranges == node->properties.end()) {
+			child_bus.translation = -1; // i2c, spi, cpus: addresses that aren't memory
+		} else if (ranges->second.empty()) {
+			child_bus.translation = bus.translation; // 1:1 with our own bus
+		} else {
+			Translation translation;
+			const size_t stride = (size_t(child_bus.address_cells) + bus.address_cells + child_bus.size_cells) * 4;
+			size_t offset = 0;
+			while (stride > 0 && offset + stride <= ranges->second.size()) {
+				Range range;
+				range.child = read_cells(ranges->second, offset, child_bus.address_cells);
+				const uint64_t parent = read_cells(ranges->second, offset, bus.address_cells);
+				range.size = read_cells(ranges->second, offset, child_bus.size_cells);
+				if (translate(translations[bus.translation], parent, range.size, range.cpu))
+					translation.ranges.push_back(range);
+			}
+			translations.push_back(std::move(translation));
+			child_bus.translation = static_cast<long>(translations.size()) - 1;
+		}
+
+		for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+			const std::string name = sanitise_string((*it)->name);
+			stack.push_back({ *it, pending.path == "/" ? "/" + name : pending.path + "/" + name, child_bus });
+		}
+	}
+
+	// containers before what they contain
+	std::sort(map.windows.begin(), map.windows.end(), [](const AddressWindow& a, const AddressWindow& b) {
+		return a.base != b.base ? a.base < b.base : a.size > b.size;
+	});
+
+	// Sweep by base, keeping the windows still open in a heap on their end.
+	// Each window overlaps exactly the ones open when it starts.
+	auto ends_later = [&](size_t a, size_t b) { return map.windows[a].end() > map.windows[b].end(); };
+	std::vector<size_t> open;
+	for (size_t i = 0; i < map.windows.size(); ++i) {
+		const AddressWindow& window = map.windows[i];
+		while (!open.empty() && map.windows[open.front()].end() <= window.base) {
+			std::pop_heap(open.begin(), open.end(), ends_later);
+			open.pop_back();
+		}
+		for (size_t j : open) {
+			const std::string& other = map.windows[j].path;
+			// a bus claiming the space of its devices is how it's meant to be
+			if (is_ancestor(other, window.path) || is_ancestor(window.path, other))
+				continue;
+			if (reserves(window, map.windows[j]) || reserves(map.windows[j], window))
+				continue;
+			map.overlaps.push_back({ j, i });
+		}
+		open.push_back(i);
+		std::push_heap(open.begin(), open.end(), ends_later);
+	}
+	std::sort(map.overlaps.begin(), map.overlaps.end(), [](const AddressOverlap& a, const AddressOverlap& b) {
+		return a.first != b.first ? a.first < b.first : a.second < b.second;
+	});
+	return map;
+}
+
+std::string address_map_text(const AddressMap& map)
+{
+	std::ostringstream text;
+	for (const auto& window : map.windows)
+		text << hex(window.base) << "-" << hex(window.end() - 1) << "  " << human_size(window.size) << "  " << window_name(window) << "\n";
+	if (!map.overlaps.empty()) {
+		text << "\n"
+		     << map.overlaps.size() << " overlapping windows:\n";
+		for (const auto& overlap : map.overlaps) {
+			const auto& first = map.windows[overlap.first];
+			const auto& second = map.windows[overlap.second];
+			const uint64_t shared = std::min(first.end(), second.end()) - second.base;
+			text << "  " << window_name(first) << " and " << window_name(second) << " share " << human_size(shared) << " at " << hex(second.base) << "\n";
+		}
+	}
+	if (map.untranslated > 0)
+		text << "\n"
+		     << map.untranslated << " reg entries have no CPU address (no ranges on the way up)\n";
+	return text.str();
+}
+
+std::string address_map_json(const AddressMap& map)
+{
+	std::ostringstream json;
+	json << "{\n  \"windows\": [";
+	for (size_t i = 0; i < map.windows.size(); ++i) {
+		const auto& window = map.windows[i];
+		json << (i ? ",\n" : "\n") << "    { \"path\": " << json_string(window.path) << ", \"reg\": " << window.reg_index
+		     << ", \"base\": \"" << hex(window.base) << "\", \"size\": \"" << hex(window.size) << "\" }";
+	}
+	json << "\n  ],\n  \"overlaps\": [";
+	for (size_t i = 0; i < map.overlaps.size(); ++i)
+		json << (i ? ", " : "") << "[" << map.overlaps[i].first << ", " << map.overlaps[i].second << "]";
+	json << "],\n  \"untranslated\": " << map.untranslated << "\n}\n";
+	return json.str();
+}
+
+std::string address_map_graph(const AddressMap& map)
+{
+	std::unordered_set<size_t> overlapping;
+	for (const auto& overlap : map.overlaps) {
+		overlapping.insert(overlap.first);
+		overlapping.insert(overlap.second);
+	}
+	// paths went through sanitise_string(), they are safe in an HTML label
+	std::ostringstream dot;
+	dot << "digraph \"Address-Map\" {\n";
+	dot << "  node [shape=plaintext];\n";
+	dot << "  map [label=<<table border=\"0\" cellborder=\"1\" cellspacing=\"0\" cellpadding=\"4\">\n";
+	dot << "    <tr><td><b>start</b></td><td><b>end</b></td><td><b>size</b></td><td><b>node</b></td></tr>\n";
+	for (size_t i = 0; i < map.windows.size(); ++i) {
+		const auto& window = map.windows[i];
+		const char* colour = overlapping.count(i) ? " bgcolor=\"#f4cccc\"" : "";
+		dot << "    <tr><td" << colour << ">" << hex(window.base) << "</td><td" << colour << ">" << hex(window.end() - 1)
+		    << "</td><td" << colour << " align=\"right\">" << human_size(window.size) << "</td><td" << colour << " align=\"left\">"
+		    << window_name(window) << "</td></tr>\n";
+	}
+	if (map.windows.empty())
+		dot << "    <tr><td colspan=\"4\">no memory mapped reg entries</td></tr>\n";
+	dot << "  </table>>];\n";
+	dot << "}\n";
+	return dot.str();
+}
@@ -0,0 +1,42 @@
+#ifndef DT2GV_ADDRESS_MAP_H
+#define DT2GV_ADDRESS_MAP_H
+#include "dt2gv/device-tree.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One `reg` entry, translated to a CPU physical address
+struct AddressWindow {
+	std::string path; // full node path, names sanitised
+	size_t reg_index; // which entry of the node's reg
+	uint64_t base;
+	uint64_t size;
+	bool memory = false; // RAM, from a device_type = "memory" node
+	uint64_t end() const; // one past the last byte, saturated
+};
+
+struct AddressOverlap {
+	size_t first; // indices into AddressMap::windows, first starts first
+	size_t second;
+};
+
+struct AddressMap {
+	std::vector<AddressWindow> windows; // sorted by base, then size
+	// ancestors and descendants don't count, nor /reserved-memory carve-outs
+	// of RAM
+	std::vector<AddressOverlap> overlaps;
+	size_t untranslated = 0; // reg entries on a bus without ranges, or outside them
+};
+
+// One top-down pass: every node's reg is read with its parent's
+// #address-cells/#size-cells and mapped through the ranges of all its
+// ancestors. Windows are sorted and swept once for overlaps, O(n log n)
+// plus the number of overlaps found.
+AddressMap build_address_map(Device_Tree_Node_t* root);
+// Sorted table, one window per line, overlaps listed after it
+std::string address_map_text(const AddressMap& map);
+std::string address_map_json(const AddressMap& map);
+// The table as a DOT graph, overlapping windows highlighted
+std::string address_map_graph(const AddressMap& map);
+#endif // DT2GV_ADDRESS_MAP_H
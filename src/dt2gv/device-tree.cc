@@ -0,0 +1,162 @@
+#include "dt2gv/device-tree.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <libfdt.h>
+#include <sstream>
+#include <stdexcept>
+
+Device_Tree_Node_t* parse_tree(void* fdt, int node_offset)
+{
+	Device_Tree_Node_t* node = new Device_Tree_Node_t();
+	node->name = fdt_get_name(fdt, node_offset, NULL);
+
+	// Parse properties
+	int property_offset;
+	fdt_for_each_property_offset(property_offset, fdt, node_offset)
+	{
+		const char* name;
+		const char* value;
+		int len;
+		value = (const char*)fdt_getprop_by_offset(fdt, property_offset, &name, &len);
+		node->properties[name] = std::string(value, len);
+	}
+
+	// Parse children
+	int child_offset;
+	fdt_for_each_subnode(child_offset, fdt, node_offset)
+	{
+		// I hope that for a finite number of subnodes, the recursive call
+		// will not be too much of an issue. If it gets tanked for big dtbs
+		// maybe migrate this whole thing to OCaml or some flavour of lisp.
+		node->children.push_back(parse_tree(fdt, child_offset));
+	}
+
+	return node;
+}
+
+std::vector<char> load_dtb(const std::string& path)
+{
+	if (path == "-")
+		return std::vector<char>(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to open DTB file: " + path);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+Device_Tree_Node_t* parse_dtb(const void* data, size_t size)
+{
+	// fdt_check_header() reads the whole header, make sure there is one
+	if (!data || size < sizeof(struct fdt_header) || fdt_check_header(data))
+		throw std::runtime_error("Invalid DTB header");
+	if (fdt_totalsize(data) > size)
+		throw std::runtime_error("Truncated DTB, header says " + std::to_string(fdt_totalsize(data)) + " bytes, got " + std::to_string(size));
+	return parse_tree(const_cast<void*>(data), 0);
+}
+
+void free_tree(Device_Tree_Node_t* root)
+{
+	std::vector<Device_Tree_Node_t*> stack { root };
+	while (!stack.empty()) {
+		Device_Tree_Node_t* node = stack.back();
+		stack.pop_back();
+		if (!node)
+			continue;
+		stack.insert(stack.end(), node->children.begin(), node->children.end());
+		delete node;
+	}
+}
+
+std::string escape_special_chars(const std::string& s)
+{
+	std::string escaped;
+	for (char c : s)
+		switch (c) {
+		case '<':
+			escaped += "&lt;";
+			break;
+		case '>':
+			escaped += "&gt;";
+			break;
+		case '&':
+			escaped += "&amp;";
+			break;
+		default:
+			escaped += c;
+			break;
+		}
+	return escaped;
+}
+
+std::string sanitise_string(const std::string& s)
+{
+	std::string sanitised;
+	for (char c : s)
+		if (c >= 32 && c <= 126)
+			sanitised += c;
+	return escape_special_chars(sanitised);
+}
+
+void create_graph(Agraph_t* graph, Device_Tree_Node_t* node)
+{
+	// Create the node using only the name as the label
+	Agnode_t* parent_node = agnode(graph, const_cast<char*>(sanitise_string(node->name).c_str()), 1);
+	agsafeset(parent_node, const_cast<char*>("label"), const_cast<char*>(sanitise_string(node->name).c_str()), const_cast<char*>(""));
+	// Add properties as a tooltip
+	if (!node->properties.empty()) {
+		std::string tooltip;
+		for (const auto& [k, v] : node->properties)
+			tooltip += sanitise_string(k) + "=" + sanitise_string(v) + "\\n";
+		agsafeset(parent_node, const_cast<char*>("tooltip"), const_cast<char*>(tooltip.c_str()), const_cast<char*>(""));
+	}
+
+	for (auto child : node->children) {
+		Agnode_t* child_node = agnode(graph, (char*)child->name.c_str(), 1);
+		agedge(graph, parent_node, child_node, nullptr, 1);
+		// Same concern, maybe not an issue
+		create_graph(graph, child);
+	}
+}
+
+std::vector<TreeNode> build_tree_nodes(Device_Tree_Node_t* root)
+{
+	// node names repeat across the tree, paths don't
+	std::vector<TreeNode> nodes;
+	std::vector<std::pair<Device_Tree_Node_t*, long>> stack { { root, -1 } };
+	while (!stack.empty()) {
+		auto [node, parent] = stack.back();
+		stack.pop_back();
+
+		TreeNode tree_node;
+		tree_node.parent = parent;
+		tree_node.label = sanitise_string(node->name);
+		tree_node.id = parent < 0 ? "/" : nodes[parent].id + (nodes[parent].id == "/" ? "" : "/") + tree_node.label;
+		tree_node.attributes = "label=\"" + escape_quotes(tree_node.label) + "\"";
+		if (!node->properties.empty()) {
+			std::string tooltip;
+			for (const auto& [k, v] : node->properties)
+				tooltip += sanitise_string(k) + "=" + sanitise_string(v) + "\\n";
+			tree_node.attributes += " tooltip=\"" + escape_quotes(tooltip) + "\"";
+		}
+		const long index = static_cast<long>(nodes.size());
+		nodes.push_back(std::move(tree_node));
+		for (auto it = node->children.rbegin(); it != node->children.rend(); ++it)
+			stack.emplace_back(*it, index);
+	}
+	return nodes;
+}
+
+std::string generate_tree_graph(Device_Tree_Node_t* root)
+{
+	const std::vector<TreeNode> nodes = build_tree_nodes(root);
+	std::ostringstream dot;
+	dot << "digraph \"Device-Tree\" {\n";
+	for (const auto& node : nodes) {
+		dot << "  \"" << escape_quotes(node.id) << "\" [" << node.attributes << "];\n";
+		if (node.parent >= 0)
+			dot << "  \"" << escape_quotes(nodes[node.parent].id) << "\" -> \"" << escape_quotes(node.id) << "\";\n";
+	}
+	dot << "}\n";
+	return dot.str();
+}
@@ -0,0 +1,32 @@
+#ifndef DT2GV_DEVICE_TREE_H
+#define DT2GV_DEVICE_TREE_H
+#include "common/tiling.h"
+#include <graphviz/gvc.h>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Device_Tree_Node_t {
+	std::string name;
+	std::map<std::string, std::string> properties;
+	std::vector<Device_Tree_Node_t*> children;
+};
+
+Device_Tree_Node_t* parse_tree(void* fdt, int node_offset);
+// Whole DTB file into memory, "-" for stdin, throws if it can't be read
+std::vector<char> load_dtb(const std::string& path);
+// Check the header against the buffer size, then parse from the root node.
+// The tree doesn't point into the buffer, it can go away afterwards.
+Device_Tree_Node_t* parse_dtb(const void* data, size_t size);
+void free_tree(Device_Tree_Node_t* root);
+// escape special chars for correct html/svg/xml rendering
+std::string escape_special_chars(const std::string& s);
+// keep only printable chars (ASCII 0x20-0x7E)
+std::string sanitise_string(const std::string& s);
+void create_graph(Agraph_t* graph, Device_Tree_Node_t* node);
+// Same nodes and tooltips as create_graph(), as a tree for render_tiled()
+std::vector<TreeNode> build_tree_nodes(Device_Tree_Node_t* root);
+// Same nodes again, as plain DOT text for render_graph_data() and friends
+std::string generate_tree_graph(Device_Tree_Node_t* root);
+#endif // DT2GV_DEVICE_TREE_H
@@ -1,150 +1,251 @@
+#include "common/layout.h"
+#include "common/output.h"
+#include "common/render-cache.h"
+#include "common/tiling.h"
+#include "dt2gv/address-map.h"
+#include "dt2gv/device-tree.h"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <getopt.h>
 #include <graphviz/gvc.h>
 #include <iostream>
-#include <libfdt.h>
-#include <map>
+#include <memory>
 #include <string>
-#include <vector>
 
-struct Device_Tree_Node_t {
-	std::string name;
-	std::map<std::string, std::string> properties;
-	std::vector<Device_Tree_Node_t*> children;
-};
-
-Device_Tree_Node_t* parse_tree(void* fdt, int node_offset)
+static void usage(const char* program)
 {
-	Device_Tree_Node_t* node = new Device_Tree_Node_t();
-	node->name = fdt_get_name(fdt, node_offset, NULL);
-
-	// Parse properties
-	int property_offset;
-	fdt_for_each_property_offset(property_offset, fdt, node_offset)
-	{
-		const char* name;
-		const char* value;
-		int len;
-		value = (const char*)fdt_getprop_by_offset(fdt, property_offset, &name, &len);
-		node->properties[name] = std::string(value, len);
-	}
+	std::cerr << "Usage: " << program << " [-o output|-] [-f format] [--tile[=nodes]] [--cache-dir dir [--cache-max MB]] [--layout-timeout seconds] [--address-map[=text|json]] <dtb_file|-> <render_engine>\n";
+	std::cerr << "Render engine options: dot, fdp, sfdp, neato, circo, twopi, auto\n";
+	std::cerr << "A dtb_file of - reads the blob from stdin, -o - writes the graph to stdout.\n";
+	std::cerr << "--address-map also renders <output>-addrmap.<format>, =text or =json prints the table instead.\n";
+}
 
-	// Parse children
-	int child_offset;
-	fdt_for_each_subnode(child_offset, fdt, node_offset)
-	{
-		// I hope that for a finite number of subnodes, the recursive call
-		// will not be too much of an issue. If it gets tanked for big dtbs
-		// maybe migrate this whole thing to OCaml or some flavour of lisp.
-		node->children.push_back(parse_tree(fdt, child_offset));
+// The physical address table as its own small graph, next to the tree
+static bool render_address_map(const AddressMap& map, const std::string& format, const std::string& path)
+{
+	GVC_t* gvc = gvContext();
+	const std::string dot = address_map_graph(map);
+	Agraph_t* graph = agmemread(const_cast<char*>(dot.c_str()));
+	bool ok = false;
+	if (graph) {
+		// one table node, any engine will do
+		LayoutOptions layout;
+		layout.engine = "dot";
+		LayoutReport report;
+		std::string rendered;
+		ok = layout_render(gvc, graph, format, layout, rendered, report) && write_output(rendered, path);
+		agclose(graph);
 	}
+	gvFreeContext(gvc);
+	if (ok)
+		std::cout << "Rendered " << path << ", " << map.windows.size() << " address windows\n";
+	else
+		std::cerr << "Failed to render " << path << "\n";
+	return ok;
+}
 
-	return node;
+// What create_graph() drew as DOT text, the cache key follows the drawing
+// rather than the blob it came from
+static bool dot_text(Agraph_t* graph, std::string& dot)
+{
+	char* buffer = nullptr;
+	size_t size = 0;
+	FILE* stream = open_memstream(&buffer, &size);
+	if (!stream)
+		return false;
+	const bool ok = agwrite(graph, stream) == 0;
+	std::fclose(stream);
+	if (ok)
+		dot.assign(buffer, size);
+	std::free(buffer);
+	return ok;
 }
 
-// escape special chars for correct html/svg/xml rendering
-std::string escape_special_chars(const std::string& s)
+int main(int argc, char** argv)
 {
-	std::string escaped;
-	for (char c : s)
-		switch (c) {
-		case '<':
-			escaped += "&lt;";
+	// stdin/stdout are only used through iostreams, skip the stdio syncing
+	std::ios::sync_with_stdio(false);
+	size_t tile_budget = 0;
+	std::string out; // <dtb stem>.<format> unless given
+	std::string format; // from out's extension unless given
+	std::string cache_dir;
+	uint64_t cache_max_mb = DEFAULT_CACHE_MAX_MB;
+	unsigned layout_timeout_ms = 0;
+	std::string address_map; // graph, text or json, none when empty
+	static const struct option long_options[] = {
+		{ "output", required_argument, nullptr, 'o' },
+		{ "format", required_argument, nullptr, 'f' },
+		{ "tile", optional_argument, nullptr, 't' },
+		{ "cache-dir", required_argument, nullptr, 'C' },
+		{ "cache-max", required_argument, nullptr, 'M' },
+		{ "layout-timeout", required_argument, nullptr, 'L' },
+		{ "address-map", optional_argument, nullptr, 'A' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "o:f:", long_options, nullptr)) != -1) {
+		switch (opt) {
+		case 'o':
+			out = optarg;
 			break;
-		case '>':
-			escaped += "&gt;";
+		case 'f':
+			format = optarg;
 			break;
-		case '&':
-			escaped += "&amp;";
+		case 't':
+			tile_budget = 2000;
+			if ((optarg && !parse_count(optarg, tile_budget)) || tile_budget == 0) {
+				std::cerr << "--tile needs a node budget above 0\n";
+				return 1;
+			}
 			break;
-		default:
-			escaped += c;
+		case 'C':
+			cache_dir = optarg;
 			break;
+		case 'M':
+			if (!parse_cache_max_mb(optarg, cache_max_mb)) {
+				std::cerr << "--cache-max needs a size in MB, at most " << (UINT64_MAX >> 20) << "\n";
+				return 1;
+			}
+			break;
+		case 'L':
+			if (!parse_layout_timeout(optarg, layout_timeout_ms)) {
+				std::cerr << "--layout-timeout needs a number of seconds above 0, at most " << UINT_MAX / 1000 << "\n";
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'A':
+			address_map = optarg ? optarg : "graph";
+			if (address_map != "graph" && address_map != "text" && address_map != "json") {
+				std::cerr << "--address-map prints text or json, or renders a graph without an argument\n";
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
 		}
-	return escaped;
-}
-
-// keep only printable chars (ASCII 0x20-0x7E)
-std::string sanitise_string(const std::string& s)
-{
-	std::string sanitised;
-	for (char c : s)
-		if (c >= 32 && c <= 126)
-			sanitised += c;
-	return escape_special_chars(sanitised);
-}
-
-void create_graph(Agraph_t* graph, Device_Tree_Node_t* node)
-{
-	// Create the node using only the name as the label
-	Agnode_t* parent_node = agnode(graph, const_cast<char*>(sanitise_string(node->name).c_str()), 1);
-	agsafeset(parent_node, const_cast<char*>("label"), const_cast<char*>(sanitise_string(node->name).c_str()), const_cast<char*>(""));
-	// Add properties as a tooltip
-	if (!node->properties.empty()) {
-		std::string tooltip;
-		for (const auto& [k, v] : node->properties)
-			tooltip += sanitise_string(k) + "=" + sanitise_string(v) + "\\n";
-		agsafeset(parent_node, const_cast<char*>("tooltip"), const_cast<char*>(tooltip.c_str()), const_cast<char*>(""));
 	}
-
-	for (auto child : node->children) {
-		Agnode_t* child_node = agnode(graph, (char*)child->name.c_str(), 1);
-		agedge(graph, parent_node, child_node, nullptr, 1);
-		// Same concern, maybe not an issue
-		create_graph(graph, child);
-	}
-}
-
-int main(int argc, char** argv)
-{
-	if (argc != 3) {
-		std::cerr << "Usage: " << argv[0] << " <dtb_file> <render_engine>\n";
-		std::cerr << "Render engine options: dot, fdp\n";
+	if (argc - optind != 2) {
+		usage(argv[0]);
 		return 1;
 	}
 
-	const char* dtb_path = argv[1];
+	const char* dtb_path = argv[optind];
 	std::string in(dtb_path);
-	std::string out = in.substr(0, in.find_last_of('.')) + ".svg";
-	const char* render_engine = argv[2];
+	const std::string stem = in == STDIO_PATH ? "device-tree" : in.substr(0, in.find_last_of('.'));
+	// a table goes to stdout unless -o says otherwise
+	const std::string table_out = out.empty() ? STDIO_PATH : out;
+	if (out.empty())
+		out = stem + "." + output_format("", format);
+	format = output_format(out, format);
+	if (out == STDIO_PATH && tile_budget > 0) {
+		std::cerr << "--tile writes several files, it can't go to stdout\n";
+		return 1;
+	}
+	if (out == STDIO_PATH && address_map == "graph") {
+		std::cerr << "--address-map renders a second file, it can't go to stdout, try --address-map=text\n";
+		return 1;
+	}
+	const char* render_engine = argv[optind + 1];
 	// validate render engine
-	if (std::string(render_engine) != "dot" && std::string(render_engine) != "fdp") {
-		std::cerr << "Invalid render engine. Choose either 'dot' or 'fdp'.\n";
+	if (!known_engine(render_engine)) {
+		std::cerr << "Invalid render engine. Choose one of dot, fdp, sfdp, neato, circo, twopi or auto.\n";
 		return 1;
 	}
 
-	// Load DTB file
-	FILE* f = fopen(dtb_path, "rb");
-	if (!f) {
-		std::cerr << "Failed to open DTB file: " << dtb_path << "\n";
+	// Load and parse DTB file
+	std::vector<char> dtb;
+	Device_Tree_Node_t* root = nullptr;
+	try {
+		dtb = load_dtb(dtb_path);
+		root = parse_dtb(dtb.data(), dtb.size());
+	} catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << "\n";
 		return 1;
 	}
-	fseek(f, 0, SEEK_END);
-	long size = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	void* fdt = malloc(size);
-	fread(fdt, 1, size, f);
-	fclose(f);
 
-	// Parse DTB file
-	if (fdt_check_header(fdt)) {
-		std::cerr << "Invalid DTB file: " << dtb_path << "\n";
-		free(fdt);
-		return 1;
+	// Physical address windows, either instead of the tree or next to it
+	if (!address_map.empty()) {
+		const AddressMap map = build_address_map(root);
+		if (address_map != "graph") {
+			const bool ok = write_output(address_map == "json" ? address_map_json(map) : address_map_text(map), table_out);
+			free_tree(root);
+			if (!ok)
+				std::cerr << "Failed to write " << table_out << "\n";
+			return ok ? 0 : 1;
+		}
+		if (!map.overlaps.empty())
+			std::cerr << "Warning: " << map.overlaps.size() << " overlapping address windows, see the address map\n";
+		const std::string map_out = std::filesystem::path(out).replace_extension().string() + "-addrmap." + format;
+		if (!render_address_map(map, format, map_out)) {
+			free_tree(root);
+			return 1;
+		}
+	}
+
+	// Huge trees get split into tiles, each laid out on its own
+	if (tile_budget > 0) {
+		TileOptions tiles;
+		tiles.node_budget = tile_budget;
+		// tiles are bounded, size the engine for a full one
+		tiles.engine = std::string(render_engine) == "auto" ? auto_engine(tile_budget, tile_budget) : render_engine;
+		tiles.format = format;
+		tiles.timeout_ms = layout_timeout_ms;
+		tiles.output_prefix = std::filesystem::path(out).replace_extension().string();
+		const bool ok = render_tiled(build_tree_nodes(root), tiles);
+		free_tree(root);
+		return ok ? 0 : 1;
 	}
-	Device_Tree_Node_t* root = parse_tree(fdt, 0);
 
 	// Create the graph
 	GVC_t* gvc = gvContext();
 	Agraph_t* graph = agopen((char*)"Device-Tree", Agdirected, nullptr);
 	// Add nodes and edges to the graph
 	create_graph(graph, root);
-	// Render
-	gvLayout(gvc, graph, render_engine);
-	gvRenderFilename(gvc, graph, "svg", out.c_str());
-	gvFreeLayout(gvc, graph);
+
+	// Same graph, engine, format and Graphviz give the same picture, skip the layout
+	std::unique_ptr<RenderCache> cache;
+	std::string cache_key, dot;
+	if (!cache_dir.empty() && dot_text(graph, dot)) {
+		cache = std::make_unique<RenderCache>(cache_dir, cache_max_mb << 20);
+		const char* graphviz = gvcVersion(gvc);
+		cache_key = ContentHash().add(RENDER_CACHE_VERSION).add("dt2gv").add(graphviz ? graphviz : "").add(render_engine).add(layout_timeout_ms).add(format).add(dot).hex();
+		std::string cached;
+		if (cache->load(cache_key, cached)) {
+			agclose(graph);
+			free_tree(root);
+			gvFreeContext(gvc);
+			if (!write_output(cached, out)) {
+				std::cerr << "Failed to write " << out << "\n";
+				return 1;
+			}
+			return 0;
+		}
+	}
+
+	// Render, within the time budget if there is one
+	LayoutOptions layout;
+	layout.engine = render_engine;
+	layout.timeout_ms = layout_timeout_ms;
+	LayoutReport report;
+	std::string rendered;
+	const bool ok = layout_render(gvc, graph, format, layout, rendered, report) && write_output(rendered, out);
+	if (ok) {
+		// only cache what the requested engine drew, not a fallback
+		if (cache && report.abandoned.empty())
+			cache->store(cache_key, rendered);
+		// stdout carries the graph itself
+		(out == STDIO_PATH ? std::cerr : std::cout) << "Rendered " << (out == STDIO_PATH ? "stdout" : out) << " " << describe(report) << "\n";
+	}
 
 	// Clean up
 	agclose(graph);
 	gvFreeContext(gvc);
-	free(fdt);
-	return 0;
+	free_tree(root);
+	if (!ok)
+		std::cerr << "Failed to render " << out << "\n";
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,130 @@
+#include "libdtv/dtv-c.h"
+#include "libdtv/dtv.h"
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+struct dtv_context {
+	explicit dtv_context(const char* config_file)
+		: context(config_file ? dtv::Context(config_file) : dtv::Context())
+	{
+	}
+
+	dtv::Context context;
+	std::string error;
+	std::string scratch; // reused by dtv_render_buffer()
+};
+
+namespace {
+// Exceptions must not cross into C, turn them into the error code + message
+template <typename Fn>
+int guarded(dtv_context* ctx, Fn&& fn)
+{
+	if (!ctx)
+		return DTV_ERROR;
+	try {
+		ctx->error.clear();
+		return fn();
+	} catch (const std::exception& e) {
+		ctx->error = e.what();
+	} catch (...) {
+		ctx->error = "Unknown error";
+	}
+	return DTV_ERROR;
+}
+
+// malloc'd copy, so C callers can free() it just as well as dtv_free()
+int hand_out(const std::string& data, char** out, size_t* out_len)
+{
+	char* copy = static_cast<char*>(std::malloc(data.size() + 1));
+	if (!copy)
+		throw std::bad_alloc();
+	std::memcpy(copy, data.data(), data.size());
+	copy[data.size()] = '\0';
+	*out = copy;
+	if (out_len)
+		*out_len = data.size();
+	return DTV_OK;
+}
+} // namespace
+
+extern "C" {
+
+int dtv_api_version(void)
+{
+	return DTV_API_VERSION;
+}
+
+dtv_context* dtv_context_new(const char* config_file)
+{
+	try {
+		return new dtv_context(config_file);
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void dtv_context_free(dtv_context* ctx)
+{
+	delete ctx;
+}
+
+const char* dtv_last_error(const dtv_context* ctx)
+{
+	return ctx ? ctx->error.c_str() : "No context";
+}
+
+int dtv_process_graph(dtv_context* ctx, const char* snapshot, size_t snapshot_len, char** dot, size_t* dot_len)
+{
+	return guarded(ctx, [&] {
+		if (!dot)
+			throw std::invalid_argument("No output pointer");
+		const auto procs = snapshot ? ctx->context.parse_processes(std::string(snapshot, snapshot_len))
+					    : ctx->context.capture_processes();
+		return hand_out(ctx->context.process_graph(procs), dot, dot_len);
+	});
+}
+
+int dtv_device_tree_graph(dtv_context* ctx, const void* dtb, size_t dtb_len, char** dot, size_t* dot_len)
+{
+	return guarded(ctx, [&] {
+		if (!dot)
+			throw std::invalid_argument("No output pointer");
+		return hand_out(ctx->context.device_tree_graph(dtb, dtb_len), dot, dot_len);
+	});
+}
+
+int dtv_render(dtv_context* ctx, const char* dot, size_t dot_len, const char* engine, const char* format, char** out, size_t* out_len)
+{
+	return guarded(ctx, [&] {
+		if (!dot || !engine || !format || !out)
+			throw std::invalid_argument("Missing argument");
+		ctx->context.render_into(std::string(dot, dot_len), format, ctx->scratch, engine);
+		return hand_out(ctx->scratch, out, out_len);
+	});
+}
+
+int dtv_render_buffer(dtv_context* ctx, const char* dot, size_t dot_len, const char* engine, const char* format, char* buf, size_t buf_size, size_t* out_len)
+{
+	return guarded(ctx, [&] {
+		if (!dot || !engine || !format || !out_len || (!buf && buf_size))
+			throw std::invalid_argument("Missing argument");
+		ctx->context.render_into(std::string(dot, dot_len), format, ctx->scratch, engine);
+		*out_len = ctx->scratch.size();
+		if (ctx->scratch.size() > buf_size)
+			return DTV_ERROR_SPACE;
+		if (!ctx->scratch.empty())
+			std::memcpy(buf, ctx->scratch.data(), ctx->scratch.size());
+		return DTV_OK;
+	});
+}
+
+void dtv_free(void* data)
+{
+	std::free(data);
+}
+
+} // extern "C"
@@ -0,0 +1,48 @@
+#ifndef LIBDTV_DTV_C_H
+#define LIBDTV_DTV_C_H
+#include <stddef.h>
+
+/* C API of libdtv, plain C so it can be used from anything with an FFI.
+ * Every call returns DTV_OK or an error code, dtv_last_error() says why.
+ * Buffers handed out by the library are released with dtv_free(). */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a declaration below changes incompatibly */
+#define DTV_API_VERSION 1
+
+#define DTV_OK 0
+#define DTV_ERROR -1 /* see dtv_last_error() */
+#define DTV_ERROR_SPACE -2 /* caller's buffer too small, *out_len says how big it has to be */
+
+/* Opaque: a long-lived GVC context plus the ps2gv config */
+typedef struct dtv_context dtv_context;
+
+/* DTV_API_VERSION of the library actually loaded */
+int dtv_api_version(void);
+
+/* config_file is a ps2gv config, NULL for the defaults. NULL on failure. */
+dtv_context* dtv_context_new(const char* config_file);
+void dtv_context_free(dtv_context* ctx);
+/* Message of the last failed call on ctx, "" if there was none */
+const char* dtv_last_error(const dtv_context* ctx);
+
+/* DOT text of a process tree. snapshot NULL captures the live process list,
+ * otherwise it is ps output of snapshot_len bytes (ps2gv input file format). */
+int dtv_process_graph(dtv_context* ctx, const char* snapshot, size_t snapshot_len, char** dot, size_t* dot_len);
+/* DOT text of a device tree blob of dtb_len bytes */
+int dtv_device_tree_graph(dtv_context* ctx, const void* dtb, size_t dtb_len, char** dot, size_t* dot_len);
+
+/* Lay out dot with engine (dot, fdp, ...) and render it as format (svg, png, json, ...) */
+int dtv_render(dtv_context* ctx, const char* dot, size_t dot_len, const char* engine, const char* format, char** out, size_t* out_len);
+/* Same, into a caller-provided buffer, no allocation handed out. Sets *out_len
+ * to the rendered size and returns DTV_ERROR_SPACE if it's over buf_size. */
+int dtv_render_buffer(dtv_context* ctx, const char* dot, size_t dot_len, const char* engine, const char* format, char* buf, size_t buf_size, size_t* out_len);
+
+void dtv_free(void* data);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* LIBDTV_DTV_C_H */
@@ -0,0 +1,161 @@
+#include "libdtv/dtv.h"
+#include "common/output.h"
+#include "dt2gv/device-tree.h"
+#include "ps2gv/config-settings.h"
+#include "ps2gv/graph-generator.h"
+#include "ps2gv/process-capture.h"
+#include "ps2gv/process-detail.h"
+#include <graphviz/gvc.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace dtv {
+
+namespace {
+	// Parsed and laid out graph, torn down in the right order whatever happens
+	struct Layout {
+		GVC_t* gvc;
+		Agraph_t* graph;
+
+		Layout(GVC_t* context, const std::string& dot, const std::string& engine)
+			: gvc(context)
+			, graph(agmemread(const_cast<char*>(dot.c_str())))
+		{
+			if (!graph)
+				throw std::runtime_error("Failed to parse DOT graph");
+			if (gvLayout(gvc, graph, engine.c_str()) != 0) {
+				agclose(graph);
+				throw std::runtime_error("Failed to layout graph with " + engine);
+			}
+		}
+		~Layout()
+		{
+			gvFreeLayout(gvc, graph);
+			agclose(graph);
+		}
+		Layout(const Layout&) = delete;
+		Layout& operator=(const Layout&) = delete;
+
+		void render(const std::string& format, std::string& out)
+		{
+			if (!render_data(gvc, graph, format, out))
+				throw std::runtime_error("Failed to render graph as " + format);
+		}
+	};
+} // namespace
+
+struct Processes::Rows {
+	std::vector<ProcessInfo> procs;
+};
+
+Processes::Processes()
+	: rows_(std::make_unique<Rows>())
+{
+}
+
+Processes::~Processes() = default;
+Processes::Processes(Processes&&) noexcept = default;
+Processes& Processes::operator=(Processes&&) noexcept = default;
+
+size_t Processes::size() const
+{
+	return rows_ ? rows_->procs.size() : 0;
+}
+
+struct Context::State {
+	GVC_t* gvc;
+	Config config;
+
+	State()
+		: gvc(gvContext())
+	{
+		if (!gvc)
+			throw std::runtime_error("Failed to create Graphviz context");
+	}
+	~State()
+	{
+		gvFreeContext(gvc);
+	}
+	State(const State&) = delete;
+	State& operator=(const State&) = delete;
+};
+
+Context::Context()
+	: state_(std::make_unique<State>())
+{
+}
+
+Context::Context(const std::string& config_file)
+	: Context()
+{
+	state_->config.load(config_file);
+}
+
+Context::~Context() = default;
+Context::Context(Context&&) noexcept = default;
+Context& Context::operator=(Context&&) noexcept = default;
+
+void Context::set(const std::string& key, const std::string& value)
+{
+	state_->config.set(key, value);
+}
+
+Processes Context::capture_processes() const
+{
+	Processes result;
+	result.rows_->procs = capture_live();
+	if (needs_process_detail(state_->config.scale_mode))
+		sample_process_detail(result.rows_->procs, state_->config);
+	return result;
+}
+
+Processes Context::parse_processes(const std::string& snapshot) const
+{
+	std::istringstream in(snapshot);
+	Processes result;
+	result.rows_->procs = parse_ps_snapshot(in);
+	return result;
+}
+
+std::string Context::process_graph(const Processes& procs) const
+{
+	static const std::vector<ProcessInfo> none; // a moved-from list
+	return generate_graph(procs.rows_ ? procs.rows_->procs : none, state_->config);
+}
+
+std::string Context::device_tree_graph(const void* dtb, size_t size) const
+{
+	Device_Tree_Node_t* root = parse_dtb(dtb, size);
+	try {
+		std::string dot = generate_tree_graph(root);
+		free_tree(root);
+		return dot;
+	} catch (...) {
+		free_tree(root);
+		throw;
+	}
+}
+
+std::string Context::render(const std::string& dot, const std::string& format, const std::string& engine)
+{
+	std::string out;
+	render_into(dot, format, out, engine);
+	return out;
+}
+
+void Context::render_into(const std::string& dot, const std::string& format, std::string& out, const std::string& engine)
+{
+	Layout layout(state_->gvc, dot, engine);
+	layout.render(format, out);
+}
+
+std::vector<std::string> Context::render_all(const std::string& dot, const std::vector<std::string>& formats, const std::string& engine)
+{
+	Layout layout(state_->gvc, dot, engine);
+	std::vector<std::string> outputs(formats.size());
+	for (size_t i = 0; i < formats.size(); ++i)
+		layout.render(formats[i], outputs[i]);
+	return outputs;
+}
+
+} // namespace dtv
@@ -0,0 +1,69 @@
+#ifndef LIBDTV_DTV_H
+#define LIBDTV_DTV_H
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// C++ API of libdtv, the capture -> parse -> graph -> render pipeline of
+// ps2gv and dt2gv without the process spawn and the files in between.
+// Only the standard library shows up here, the tools' own types stay inside.
+// See dtv-c.h for the C API.
+namespace dtv {
+
+// Bumped whenever a declaration below changes incompatibly
+constexpr int API_VERSION = 1;
+
+// A process list, captured or parsed, for process_graph()
+class Processes {
+public:
+	Processes();
+	~Processes();
+	Processes(Processes&&) noexcept;
+	Processes& operator=(Processes&&) noexcept;
+
+	size_t size() const;
+
+private:
+	friend class Context;
+	struct Rows;
+	std::unique_ptr<Rows> rows_;
+};
+
+// Long-lived render state: one Graphviz context reused by every render, plus
+// the ps2gv settings. Graphviz keeps global state, so use a context from one
+// thread at a time.
+class Context {
+public:
+	Context();
+	explicit Context(const std::string& config_file);
+	~Context();
+	Context(Context&&) noexcept;
+	Context& operator=(Context&&) noexcept;
+
+	// A ps2gv config setting, same keys and values as the config file
+	// ("scale_mode", "rss"), an unknown key is ignored
+	void set(const std::string& key, const std::string& value);
+
+	// Capture: live process list, plus whatever the scale mode needs from /proc
+	Processes capture_processes() const;
+	// Parse: ps output already in memory, same formats as ps2gv's input files
+	Processes parse_processes(const std::string& snapshot) const;
+
+	// Graph: DOT text
+	std::string process_graph(const Processes& procs) const;
+	std::string device_tree_graph(const void* dtb, size_t size) const;
+
+	// Render: lay out with engine and render as format (svg, png, json, ...).
+	// render_into() reuses out's capacity, render_all() lays out only once.
+	std::string render(const std::string& dot, const std::string& format, const std::string& engine = "fdp");
+	void render_into(const std::string& dot, const std::string& format, std::string& out, const std::string& engine = "fdp");
+	std::vector<std::string> render_all(const std::string& dot, const std::vector<std::string>& formats, const std::string& engine = "fdp");
+
+private:
+	struct State;
+	std::unique_ptr<State> state_;
+};
+
+} // namespace dtv
+#endif // LIBDTV_DTV_H
@@ -1,20 +1,146 @@
 #include "ps2gv/cli-parser.h"
+#include "common/layout.h"
+#include "common/render-cache.h"
+#include "common/tiling.h"
+#include <algorithm>
+#include <climits>
+#include <getopt.h>
 #include <iostream>
+#include <string>
 #include <unistd.h>
 
+static constexpr size_t DEFAULT_TILE_BUDGET = 2000;
+static constexpr unsigned DEFAULT_FOLD_MIN_HOSTS = 2;
+
+static void usage(const char* program)
+{
+	std::cerr << "Usage: " << program << " [-c config_file] [-o output|-] [-f format] [--events] [--threads[=pid,...]] [--ipc] [--tile[=nodes]] [input_files...|-]\n"
+		  << "       " << program << " [-c config_file] [-o output|-] [-f format] --diff before_file after_file\n"
+		  << "       " << program << " [-c config_file] [-o output|-] [-f format] --merge [--fold[=hosts]] host_files...\n"
+		  << "       " << program << " [-c config_file] --record trace_file [--at time] [input_files...|-]\n"
+		  << "       " << program << " [-c config_file] [-o output|-] [-f format] --replay trace_file [--at time]\n"
+		  << "       " << program << " [-c config_file] --serve unix:/path|[localhost:]port [--events] [--engine name|auto] [--layout-timeout seconds]\n"
+		  << "Add --cache-dir dir [--cache-max MB] to reuse renders of unchanged graphs.\n"
+		  << "Add --engine name|auto and --layout-timeout seconds to pick and bound the layout.\n"
+		  << "An input of - reads a ps snapshot from stdin, -o - writes the graph to stdout.\n";
+}
+
 Options parse_args(int argc, char* argv[])
 {
 	Options options;
 	int opt;
 
+	static const struct option long_options[] = {
+		{ "config", required_argument, nullptr, 'c' },
+		{ "output", required_argument, nullptr, 'o' },
+		{ "format", required_argument, nullptr, 'f' },
+		{ "diff", no_argument, nullptr, 'd' },
+		{ "merge", no_argument, nullptr, 'm' },
+		{ "fold", optional_argument, nullptr, 'F' },
+		{ "record", required_argument, nullptr, 'r' },
+		{ "replay", required_argument, nullptr, 'p' },
+		{ "at", required_argument, nullptr, 'a' },
+		{ "serve", required_argument, nullptr, 's' },
+		{ "events", no_argument, nullptr, 'e' },
+		{ "tile", optional_argument, nullptr, 't' },
+		{ "threads", optional_argument, nullptr, 'T' },
+		{ "ipc", no_argument, nullptr, 'I' },
+		{ "engine", required_argument, nullptr, 'E' },
+		{ "layout-timeout", required_argument, nullptr, 'L' },
+		{ "cache-dir", required_argument, nullptr, 'C' },
+		{ "cache-max", required_argument, nullptr, 'M' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+
 	// parse commandline options
-	while ((opt = getopt(argc, argv, "c:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "c:o:f:", long_options, nullptr)) != -1) {
 		switch (opt) {
 		case 'c':
 			options.config_file = optarg;
 			break;
+		case 'o':
+			options.output_file = optarg;
+			break;
+		case 'f':
+			options.format = optarg;
+			break;
+		case 'd':
+			options.diff_mode = true;
+			break;
+		case 'm':
+			options.merge_mode = true;
+			break;
+		case 'F': {
+			size_t hosts = DEFAULT_FOLD_MIN_HOSTS;
+			if ((optarg && !parse_count(optarg, hosts)) || hosts < 2 || hosts > UINT_MAX) {
+				std::cerr << "Error: --fold needs a subtree to repeat on at least 2 hosts\n";
+				exit(EXIT_FAILURE);
+			}
+			options.fold_min_hosts = static_cast<unsigned>(hosts);
+			break;
+		}
+		case 'r':
+			options.record_file = optarg;
+			break;
+		case 'p':
+			options.replay_file = optarg;
+			break;
+		case 'a':
+			options.at_time = optarg;
+			break;
+		case 's':
+			options.serve_address = optarg;
+			break;
+		case 'e':
+			options.use_events = true;
+			break;
+		case 't':
+			options.tile_budget = DEFAULT_TILE_BUDGET;
+			if ((optarg && !parse_count(optarg, options.tile_budget)) || options.tile_budget == 0) {
+				std::cerr << "Error: --tile needs a node budget above 0\n";
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'I':
+			options.show_ipc = true;
+			break;
+		case 'E':
+			options.engine = optarg;
+			if (!known_engine(options.engine)) {
+				std::cerr << "Error: --engine is one of dot, fdp, sfdp, neato, circo, twopi or auto\n";
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'L':
+			if (!parse_layout_timeout(optarg, options.layout_timeout_ms)) {
+				std::cerr << "Error: --layout-timeout needs a number of seconds above 0, at most " << UINT_MAX / 1000 << "\n";
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'C':
+			options.cache_dir = optarg;
+			break;
+		case 'M':
+			if (!parse_cache_max_mb(optarg, options.cache_max_mb)) {
+				std::cerr << "Error: --cache-max needs a size in MB, at most " << (UINT64_MAX >> 20) << "\n";
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'T': {
+			options.show_threads = true;
+			std::string pids = optarg ? optarg : "";
+			for (size_t start = 0; start < pids.size();) {
+				size_t end = pids.find(',', start);
+				if (end == std::string::npos)
+					end = pids.size();
+				if (end > start)
+					options.thread_pids.push_back(pids.substr(start, end - start));
+				start = end + 1;
+			}
+			break;
+		}
 		case '?':
-			std::cerr << "Usage: " << argv[0] << " [-c config_file] [input_files...]\n";
+			usage(argv[0]);
 			exit(EXIT_FAILURE);
 		}
 	}
@@ -24,5 +150,71 @@ Options parse_args(int argc, char* argv[])
 		while (optind < argc)
 			options.input_files.push_back(argv[optind++]);
 	}
+	if (options.diff_mode + options.merge_mode + !options.record_file.empty() + !options.replay_file.empty() + !options.serve_address.empty() > 1) {
+		std::cerr << "Error: --diff, --merge, --record, --replay and --serve are mutually exclusive\n";
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if ((!options.replay_file.empty() || !options.serve_address.empty()) && !options.input_files.empty()) {
+		std::cerr << "Error: --replay and --serve do not take input files\n";
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (options.show_threads && (!options.use_ps_command || options.diff_mode || !options.record_file.empty() || !options.replay_file.empty() || !options.serve_address.empty())) {
+		std::cerr << "Error: --threads reads /proc, it needs a live capture\n";
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (options.show_ipc && (!options.use_ps_command || options.diff_mode || options.merge_mode || !options.record_file.empty() || !options.replay_file.empty() || !options.serve_address.empty())) {
+		std::cerr << "Error: --ipc reads /proc, it needs a live capture\n";
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (options.show_ipc && options.tile_budget > 0) {
+		std::cerr << "Error: --ipc edges cross tiles, --tile can't draw them\n";
+		exit(EXIT_FAILURE);
+	}
+	if (std::count(options.input_files.begin(), options.input_files.end(), "-") > 1) {
+		std::cerr << "Error: stdin can only be read once\n";
+		exit(EXIT_FAILURE);
+	}
+	if (!options.output_file.empty() && options.input_files.size() > 1 && !options.diff_mode && !options.merge_mode) {
+		std::cerr << "Error: -o takes a single input, drop it to get one output per input file\n";
+		exit(EXIT_FAILURE);
+	}
+	if (options.output_file == "-" && options.tile_budget > 0) {
+		std::cerr << "Error: --tile writes several files, it can't go to stdout\n";
+		exit(EXIT_FAILURE);
+	}
+	if (!options.at_time.empty() && options.replay_file.empty() && options.record_file.empty()) {
+		std::cerr << "Error: --at only applies to --replay and --record\n";
+		exit(EXIT_FAILURE);
+	}
+	if (!options.at_time.empty() && !options.record_file.empty() && options.input_files.size() > 1) {
+		std::cerr << "Error: --at stamps a single snapshot, files get their modification time\n";
+		exit(EXIT_FAILURE);
+	}
+	if (options.record_file == "-") {
+		std::cerr << "Error: --record needs a seekable file, not stdout\n";
+		exit(EXIT_FAILURE);
+	}
+	if (options.merge_mode && options.input_files.empty()) {
+		std::cerr << "Error: --merge expects one snapshot file per host\n";
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (options.fold_min_hosts > 0 && !options.merge_mode) {
+		std::cerr << "Error: --fold only applies to --merge\n";
+		exit(EXIT_FAILURE);
+	}
+	if (options.merge_mode && options.tile_budget > 0) {
+		std::cerr << "Error: --tile can't split a --merge graph by host clusters\n";
+		exit(EXIT_FAILURE);
+	}
+	if (options.diff_mode && options.input_files.size() != 2) {
+		std::cerr << "Error: --diff expects exactly two snapshot files\n";
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
 	return options;
 }
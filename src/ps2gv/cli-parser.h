@@ -1,13 +1,32 @@
 #ifndef PS2GV_PARSER_H
 #define PS2GV_PARSER_H
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 struct Options {
 	std::vector<std::string> input_files;
-	std::string output_file = "ptree.svg";
+	std::string output_file; // -o file, "-" for stdout, derived from the input when empty
+	std::string format; // -f svg|dot|json|..., else from the output file's extension
+	std::string engine = "fdp"; // --engine, any Graphviz engine or auto
+	unsigned layout_timeout_ms = 0; // --layout-timeout, 0: no budget
 	std::string config_file = "ps2gv.conf";
 	bool use_ps_command = true;
+	size_t tile_budget = 0; // --tile[=nodes], 0: one graph
+	bool use_events = false; // --events, netlink proc connector instead of polling ps
+	bool show_threads = false; // --threads[=pid,...]
+	std::vector<std::string> thread_pids; // empty: every process above thread_min_cpu
+	bool show_ipc = false; // --ipc, pipe and socket edges
+	bool diff_mode = false; // --diff before after
+	bool merge_mode = false; // --merge host1 host2 ...
+	unsigned fold_min_hosts = 0; // --fold[=hosts], 0: no folding
+	std::string record_file; // --record out.pstrace
+	std::string replay_file; // --replay out.pstrace
+	std::string at_time; // --at <time>: frame to replay (latest when empty), or when a single recorded snapshot was taken
+	std::string serve_address; // --serve unix:/path | [localhost:]port
+	std::string cache_dir; // --cache-dir, no render cache when empty
+	uint64_t cache_max_mb = 256; // --cache-max
 };
 
 Options parse_args(int argc, char* argv[]);
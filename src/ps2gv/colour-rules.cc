@@ -0,0 +1,226 @@
+#include "ps2gv/colour-rules.h"
+#include <algorithm>
+#include <fnmatch.h>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+bool has_glob_chars(const std::string& s)
+{
+	return s.find_first_of("*?[") != std::string::npos;
+}
+} // namespace
+
+ColourRule parse_colour_rule(const std::string& spec)
+{
+	std::istringstream stream(spec);
+	std::string kind;
+	ColourRule rule;
+	if (!(stream >> kind >> rule.pattern >> rule.colour))
+		throw std::invalid_argument("expected '<glob|prefix|suffix|regex> <pattern> <colour> [priority]'");
+	if (!(stream >> rule.priority))
+		rule.priority = 0;
+
+	if (kind == "glob") {
+		// the common shapes go into the tries, only real globs are left over
+		const std::string& p = rule.pattern;
+		if (!has_glob_chars(p)) {
+			rule.kind = RuleKind::Exact;
+		} else if (p.back() == '*' && !has_glob_chars(p.substr(0, p.size() - 1))) {
+			rule.kind = RuleKind::Prefix;
+			rule.pattern.pop_back();
+		} else if (p.front() == '*' && !has_glob_chars(p.substr(1))) {
+			rule.kind = RuleKind::Suffix;
+			rule.pattern.erase(0, 1);
+		} else {
+			rule.kind = RuleKind::Glob;
+		}
+	} else if (kind == "prefix") {
+		rule.kind = RuleKind::Prefix;
+		if (rule.pattern.back() == '*')
+			rule.pattern.pop_back();
+	} else if (kind == "suffix") {
+		rule.kind = RuleKind::Suffix;
+		if (rule.pattern.front() == '*')
+			rule.pattern.erase(0, 1);
+	} else if (kind == "regex") {
+		rule.kind = RuleKind::Regex;
+		std::regex validate(rule.pattern); // throws std::regex_error early, at load time
+	} else {
+		throw std::invalid_argument("unknown colour rule kind '" + kind + "'");
+	}
+	return rule;
+}
+
+uint32_t ColourMatcher::Trie::insert(const std::string& key, bool reversed)
+{
+	uint32_t node = 0;
+	for (size_t i = 0; i < key.size(); ++i) {
+		const unsigned char byte = static_cast<unsigned char>(reversed ? key[key.size() - 1 - i] : key[i]);
+		auto [it, inserted] = edges.emplace((static_cast<uint64_t>(node) << 8) | byte, static_cast<uint32_t>(nodes.size()));
+		if (inserted)
+			nodes.emplace_back();
+		node = it->second;
+	}
+	return node;
+}
+
+int64_t ColourMatcher::Trie::child(uint32_t node, unsigned char byte) const
+{
+	const auto it = edges.find((static_cast<uint64_t>(node) << 8) | byte);
+	return it == edges.end() ? -1 : static_cast<int64_t>(it->second);
+}
+
+ColourMatcher::ColourMatcher(const ColourMatcher& other)
+    : rules_(other.rules_)
+    , regexes_(other.regexes_)
+    , forward_(other.forward_)
+    , reverse_(other.reverse_)
+    , generic_(other.generic_)
+{
+}
+
+ColourMatcher& ColourMatcher::operator=(const ColourMatcher& other)
+{
+	if (this != &other) {
+		rules_ = other.rules_;
+		regexes_ = other.regexes_;
+		forward_ = other.forward_;
+		reverse_ = other.reverse_;
+		generic_ = other.generic_;
+		std::lock_guard<std::mutex> lock(cache_mutex_);
+		cache_.clear();
+	}
+	return *this;
+}
+
+void ColourMatcher::compile(const std::map<std::string, std::string>& exact_colours, const std::vector<ColourRule>& rules)
+{
+	rules_.clear();
+	for (const auto& [name, colour] : exact_colours) {
+		if (name == "default")
+			continue;
+		ColourRule rule;
+		rule.pattern = name;
+		rule.colour = colour;
+		rules_.push_back(rule);
+	}
+	rules_.insert(rules_.end(), rules.begin(), rules.end());
+
+	forward_ = Trie {};
+	reverse_ = Trie {};
+	generic_.clear();
+	regexes_.assign(rules_.size(), std::regex {});
+	for (size_t i = 0; i < rules_.size(); ++i) {
+		ColourRule& rule = rules_[i];
+		rule.order = i;
+		const auto index = static_cast<int32_t>(i);
+		switch (rule.kind) {
+		case RuleKind::Exact: {
+			auto& slot = forward_.nodes[forward_.insert(rule.pattern, false)].terminal;
+			if (better(index, slot))
+				slot = index;
+			break;
+		}
+		case RuleKind::Prefix: {
+			auto& slot = forward_.nodes[forward_.insert(rule.pattern, false)].prefix;
+			if (better(index, slot))
+				slot = index;
+			break;
+		}
+		case RuleKind::Suffix: {
+			auto& slot = reverse_.nodes[reverse_.insert(rule.pattern, true)].prefix;
+			if (better(index, slot))
+				slot = index;
+			break;
+		}
+		case RuleKind::Regex:
+			regexes_[i] = std::regex(rule.pattern, std::regex::ECMAScript | std::regex::optimize);
+			generic_.push_back(index);
+			break;
+		case RuleKind::Glob:
+			generic_.push_back(index);
+			break;
+		}
+	}
+	std::sort(generic_.begin(), generic_.end(), [this](int32_t a, int32_t b) { return better(a, b); });
+
+	std::lock_guard<std::mutex> lock(cache_mutex_);
+	cache_.clear();
+}
+
+// priority, then exact > prefix > suffix > glob > regex, then the longer
+// pattern, then whichever was declared first
+bool ColourMatcher::better(int32_t candidate, int32_t current) const
+{
+	if (current < 0)
+		return true;
+	const ColourRule& a = rules_[candidate];
+	const ColourRule& b = rules_[current];
+	if (a.priority != b.priority)
+		return a.priority > b.priority;
+	if (a.kind != b.kind)
+		return a.kind < b.kind;
+	if (a.pattern.size() != b.pattern.size())
+		return a.pattern.size() > b.pattern.size();
+	return a.order < b.order;
+}
+
+int32_t ColourMatcher::match(const std::string& name) const
+{
+	int32_t best = -1;
+	auto consider = [&](int32_t rule) {
+		if (rule >= 0 && better(rule, best))
+			best = rule;
+	};
+
+	// exact and prefix rules, one walk front to back
+	uint32_t node = 0;
+	size_t depth = 0;
+	consider(forward_.nodes[0].prefix);
+	for (; depth < name.size(); ++depth) {
+		const int64_t next = forward_.child(node, static_cast<unsigned char>(name[depth]));
+		if (next < 0)
+			break;
+		node = static_cast<uint32_t>(next);
+		consider(forward_.nodes[node].prefix);
+	}
+	if (depth == name.size())
+		consider(forward_.nodes[node].terminal);
+
+	// suffix rules, one walk back to front
+	node = 0;
+	consider(reverse_.nodes[0].prefix);
+	for (size_t i = name.size(); i > 0; --i) {
+		const int64_t next = reverse_.child(node, static_cast<unsigned char>(name[i - 1]));
+		if (next < 0)
+			break;
+		node = static_cast<uint32_t>(next);
+		consider(reverse_.nodes[node].prefix);
+	}
+
+	// generic rules are sorted best first, so the first hit is the only one
+	// worth having and lower priorities than the trie result are never tried
+	for (const int32_t rule : generic_) {
+		if (best >= 0 && !better(rule, best))
+			break;
+		const ColourRule& r = rules_[rule];
+		const bool hit = (r.kind == RuleKind::Glob)
+		    ? fnmatch(r.pattern.c_str(), name.c_str(), 0) == 0
+		    : std::regex_search(name, regexes_[rule]);
+		if (hit) {
+			best = rule;
+			break;
+		}
+	}
+	return best;
+}
+
+const std::string* ColourMatcher::resolve(const std::string& name) const
+{
+	std::lock_guard<std::mutex> lock(cache_mutex_);
+	auto it = cache_.find(name);
+	if (it == cache_.end())
+		it = cache_.emplace(name, match(name)).first;
+	return it->second >= 0 ? &rules_[it->second].colour : nullptr;
+}
@@ -0,0 +1,70 @@
+#ifndef PS2GV_COLOUR_RULES_H
+#define PS2GV_COLOUR_RULES_H
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class RuleKind {
+	Exact,
+	Prefix, // "kworker/*"
+	Suffix, // "*.service"
+	Glob, // anything else with * ? or [...]
+	Regex
+};
+
+struct ColourRule {
+	RuleKind kind = RuleKind::Exact;
+	std::string pattern; // for prefix/suffix, the literal part only
+	std::string colour;
+	int priority = 0; // higher wins
+	size_t order = 0; // declaration order, earlier wins ties
+};
+
+// "glob python3.* palegreen3 10" -> rule, "prefix"/"suffix"/"regex" work too.
+// Throws std::invalid_argument on malformed specs.
+ColourRule parse_colour_rule(const std::string& spec);
+
+// Colour rules compiled into a forward trie (exact + prefix) and a reverse
+// trie (suffix), so resolving a name walks it once in each direction however
+// many of those rules there are. Generic globs and regexes are checked in
+// priority order only when they can still beat the trie result, and every
+// distinct name is resolved once and then cached.
+class ColourMatcher {
+public:
+	ColourMatcher() = default;
+	ColourMatcher(const ColourMatcher& other);
+	ColourMatcher& operator=(const ColourMatcher& other);
+
+	void compile(const std::map<std::string, std::string>& exact_colours, const std::vector<ColourRule>& rules);
+	// nullptr when no rule matches
+	const std::string* resolve(const std::string& name) const;
+
+private:
+	struct TrieNode {
+		int32_t terminal = -1; // exact match, forward trie only
+		int32_t prefix = -1; // prefix match, or suffix match in the reverse trie
+	};
+	struct Trie {
+		std::vector<TrieNode> nodes = std::vector<TrieNode>(1); // root
+		std::unordered_map<uint64_t, uint32_t> edges; // (node << 8 | byte) -> node
+		uint32_t insert(const std::string& key, bool reversed);
+		int64_t child(uint32_t node, unsigned char byte) const;
+	};
+
+	bool better(int32_t candidate, int32_t current) const;
+	int32_t match(const std::string& name) const;
+
+	std::vector<ColourRule> rules_;
+	std::vector<std::regex> regexes_; // parallel to rules_, only set for Regex
+	Trie forward_;
+	Trie reverse_;
+	std::vector<int32_t> generic_; // glob/regex rules, best first
+
+	mutable std::mutex cache_mutex_;
+	mutable std::unordered_map<std::string, int32_t> cache_;
+};
+#endif // PS2GV_COLOUR_RULES_H
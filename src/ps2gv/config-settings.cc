@@ -1,7 +1,28 @@
 #include "ps2gv/config-settings.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
+Config::Config()
+{
+	compile_colour_rules();
+}
+
+void Config::compile_colour_rules()
+{
+	colour_matcher.compile(command_colours, colour_rules);
+}
+
+const std::string& Config::colour_for(const std::string& name, const std::string& fallback_name) const
+{
+	if (const auto* colour = colour_matcher.resolve(name))
+		return *colour;
+	if (!fallback_name.empty())
+		if (const auto* colour = colour_matcher.resolve(fallback_name))
+			return *colour;
+	return command_colours.at("default");
+}
+
 void Config::load(const std::string& filename)
 {
 	std::ifstream file(filename);
@@ -34,38 +55,89 @@ void Config::load(const std::string& filename)
 		trim(key);
 		trim(value);
 
-		try {
-			if (key == "hide_zones")
-				hide_zones = (value == "true");
-			else if (key == "min_rss_threshold")
-				min_rss_threshold = std::stof(value);
-			else if (key == "rss_limit")
-				rss_limit = std::stof(value);
-			else if (key == "scale_mode") {
-				if (value == "cpu")
-					scale_mode = ScaleMode::CPU;
-				else if (value == "rss")
-					scale_mode = ScaleMode::RSS;
-				else
-					std::cerr << "Warning: Unknown scale_mode '" << value << "'. Valid options are 'cpu' or 'rss'.\n";
-			} else if (key == "min_cpu_threshold")
-				min_cpu_threshold = std::stof(value);
-			else if (key == "cpu_limit")
-				cpu_limit = std::stof(value);
-			else if (key == "base_width")
-				base_width = std::stof(value);
-			else if (key == "width_factor")
-				width_factor = std::stof(value);
-			else if (key == "base_height")
-				base_height = std::stof(value);
-			else if (key == "height_factor")
-				height_factor = std::stof(value);
-			else if (key.rfind("colour.", 0) == 0 && key.length() > 7) {
-				std::string comm = key.substr(7);
-				command_colours[comm] = value;
-			}
-		} catch (const std::exception& e) {
-			std::cerr << "Warning: Invalid config value for '" << key << "' - " << e.what() << std::endl;
-		}
+		assign(key, value);
+	}
+	compile_colour_rules();
+}
+
+void Config::set(const std::string& key, const std::string& value)
+{
+	assign(key, value);
+	compile_colour_rules();
+}
+
+void Config::assign(const std::string& key, const std::string& value)
+{
+	try {
+		if (key == "hide_zones")
+			hide_zones = (value == "true");
+		else if (key == "min_rss_threshold")
+			min_rss_threshold = std::stof(value);
+		else if (key == "rss_limit")
+			rss_limit = std::stof(value);
+		else if (key == "scale_mode") {
+			if (value == "cpu")
+				scale_mode = ScaleMode::CPU;
+			else if (value == "rss")
+				scale_mode = ScaleMode::RSS;
+			else if (value == "io")
+				scale_mode = ScaleMode::IO;
+			else if (value == "pss")
+				scale_mode = ScaleMode::PSS;
+			else if (value == "uss")
+				scale_mode = ScaleMode::USS;
+			else
+				std::cerr << "Warning: Unknown scale_mode '" << value << "'. Valid options are 'cpu', 'rss', 'io', 'pss' or 'uss'.\n";
+		} else if (key == "min_cpu_threshold")
+			min_cpu_threshold = std::stof(value);
+		else if (key == "cpu_limit")
+			cpu_limit = std::stof(value);
+		else if (key == "io_limit")
+			io_limit = std::stof(value);
+		else if (key == "min_io_threshold")
+			min_io_threshold = std::stof(value);
+		else if (key == "io_sample_interval_ms")
+			io_sample_interval_ms = std::max(1, std::stoi(value));
+		else if (key == "detail_min_rss")
+			detail_min_rss = std::stof(value);
+		else if (key == "detail_workers")
+			detail_workers = static_cast<unsigned>(std::max(0, std::stoi(value)));
+		else if (key == "base_width")
+			base_width = std::stof(value);
+		else if (key == "width_factor")
+			width_factor = std::stof(value);
+		else if (key == "base_height")
+			base_height = std::stof(value);
+		else if (key == "height_factor")
+			height_factor = std::stof(value);
+		else if (key == "serve_interval_ms")
+			serve_interval_ms = std::max(100, std::stoi(value));
+		else if (key == "event_window_ms")
+			event_window_ms = std::max(0, std::stoi(value));
+		else if (key == "event_full_refresh")
+			event_full_refresh = static_cast<unsigned>(std::max(0, std::stoi(value)));
+		else if (key == "thread_min_cpu")
+			thread_min_cpu = std::stof(value);
+		else if (key == "thread_sample_interval_ms")
+			thread_sample_interval_ms = std::max(1, std::stoi(value));
+		else if (key == "ipc_max_fds")
+			ipc_max_fds = static_cast<unsigned>(std::max(1, std::stoi(value)));
+		else if (key == "diff_rss_delta")
+			diff_rss_delta = std::stof(value);
+		else if (key == "diff_cpu_delta")
+			diff_cpu_delta = std::stof(value);
+		else if (key == "diff_new_colour")
+			diff_new_colour = value;
+		else if (key == "diff_exited_colour")
+			diff_exited_colour = value;
+		else if (key == "diff_changed_colour")
+			diff_changed_colour = value;
+		else if (key.rfind("colour.", 0) == 0 && key.length() > 7) {
+			std::string comm = key.substr(7);
+			command_colours[comm] = value;
+		} else if (key == "colour_rule")
+			colour_rules.push_back(parse_colour_rule(value));
+	} catch (const std::exception& e) {
+		std::cerr << "Warning: Invalid config value for '" << key << "' - " << e.what() << std::endl;
 	}
 }
@@ -1,21 +1,36 @@
 #ifndef PS2GV_SETTINGS_H
 #define PS2GV_SETTINGS_H
+#include "ps2gv/colour-rules.h"
 #include <map>
 #include <string>
+#include <vector>
 
 enum class ScaleMode {
 	CPU,
-	RSS
+	RSS,
+	IO, // read+write rate
+	PSS, // proportional set size
+	USS // unique set size
 };
 
 struct Config {
+	Config();
 	void load(const std::string& filepath);
+	// One config file line, key = value, warns like load() on bad values
+	void set(const std::string& key, const std::string& value);
+	// colour for a command or unit name (or else `fallback_name`), see colour_rules
+	const std::string& colour_for(const std::string& name, const std::string& fallback_name = "") const;
 	// scaling
 	ScaleMode scale_mode = ScaleMode::CPU;
 	float cpu_limit = 10.0f;
 	float min_cpu_threshold = 0.1f; // cpu < 0.1 gets no scaling
-	float rss_limit = 15000.0f; // Arbitrary 15MB
+	float rss_limit = 15000.0f; // Arbitrary 15MB, also used for pss/uss
 	float min_rss_threshold = 1000.0f; // 1MB
+	float io_limit = 10240.0f; // 10MB/s
+	float min_io_threshold = 10.0f; // 10KB/s
+	int io_sample_interval_ms = 1000;
+	float detail_min_rss = 1000.0f; // smaps_rollup only read above this RSS
+	unsigned detail_workers = 0; // 0: one per core
 	float base_width = 1.0f;
 	float width_factor = 1.8f;
 	float base_height = 0.7f;
@@ -23,6 +38,22 @@ struct Config {
 	int base_font_size = 10;
 	// zones
 	bool hide_zones = false;
+	// serve mode
+	int serve_interval_ms = 5000;
+	// event driven capture (--events)
+	int event_window_ms = 1000;
+	unsigned event_full_refresh = 10; // every Nth sample re-reads every process
+	// thread view (--threads)
+	float thread_min_cpu = 5.0f; // without a pid list, expand processes at or above this %CPU
+	int thread_sample_interval_ms = 500;
+	// IPC edges (--ipc)
+	unsigned ipc_max_fds = 4096; // fds read per process, some daemons hold 100k
+	// snapshot diff
+	float diff_rss_delta = 1000.0f; // 1MB, |after - before| to count as changed
+	float diff_cpu_delta = 1.0f;
+	std::string diff_new_colour = "green4";
+	std::string diff_exited_colour = "red3";
+	std::string diff_changed_colour = "orange";
 	// TODO: animation
 	// int frame_delay_ms = 500;
 	// bool create_animation = false;
@@ -155,5 +186,13 @@ struct Config {
 		{ "zsched", "paleturquoise3" },
 		{ "zsh", "paleturquoise3" }
 	};
+	// pattern rules, "colour_rule = <glob|prefix|suffix|regex> <pattern> <colour> [priority]"
+	std::vector<ColourRule> colour_rules;
+	// command_colours + colour_rules, rebuilt by load()
+	ColourMatcher colour_matcher;
+
+private:
+	void assign(const std::string& key, const std::string& value);
+	void compile_colour_rules();
 };
 #endif // PS2GV_SETTINGS_H
@@ -0,0 +1,165 @@
+#include "ps2gv/fleet-merge.h"
+#include "common/parallel-for.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+bool valid_pid(const ProcessInfo& proc)
+{
+	return !proc.pid.empty() && std::isdigit(proc.pid[0]);
+}
+
+uint64_t mix(uint64_t h, uint64_t value)
+{
+	h ^= value + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	h ^= h >> 31;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	return h ^ (h >> 29);
+}
+
+struct HostTree {
+	std::vector<std::vector<size_t>> children;
+	std::vector<size_t> roots; // parent not in the snapshot
+	std::vector<size_t> preorder;
+	std::vector<uint64_t> hash;
+};
+
+HostTree build_tree(const std::vector<ProcessInfo>& procs)
+{
+	HostTree tree;
+	tree.children.resize(procs.size());
+	tree.hash.assign(procs.size(), 0);
+	std::unordered_map<std::string, size_t> index_of;
+	index_of.reserve(procs.size());
+	for (size_t i = 0; i < procs.size(); ++i)
+		if (valid_pid(procs[i]))
+			index_of.emplace(procs[i].pid, i);
+	for (size_t i = 0; i < procs.size(); ++i) {
+		if (!valid_pid(procs[i]))
+			continue;
+		const auto parent = index_of.find(procs[i].ppid);
+		if (parent == index_of.end() || parent->second == i)
+			tree.roots.push_back(i);
+		else
+			tree.children[parent->second].push_back(i);
+	}
+
+	// pre-order from the roots, a ppid cycle nobody reaches is left out
+	std::vector<char> seen(procs.size(), 0);
+	std::vector<size_t> stack(tree.roots.rbegin(), tree.roots.rend());
+	while (!stack.empty()) {
+		const size_t node = stack.back();
+		stack.pop_back();
+		if (seen[node])
+			continue;
+		seen[node] = 1;
+		tree.preorder.push_back(node);
+		for (auto it = tree.children[node].rbegin(); it != tree.children[node].rend(); ++it)
+			stack.push_back(*it);
+	}
+
+	// children before parents: reverse pre-order
+	const std::hash<std::string> hash_string;
+	std::vector<uint64_t> child_hashes;
+	for (auto it = tree.preorder.rbegin(); it != tree.preorder.rend(); ++it) {
+		const ProcessInfo& proc = procs[*it];
+		child_hashes.clear();
+		for (size_t child : tree.children[*it])
+			child_hashes.push_back(tree.hash[child]);
+		// sibling order is just pid order, not part of the shape
+		std::sort(child_hashes.begin(), child_hashes.end());
+		uint64_t h = mix(hash_string(proc.command), hash_string(proc.unit));
+		for (uint64_t child : child_hashes)
+			h = mix(h, child);
+		tree.hash[*it] = mix(h, child_hashes.size());
+	}
+	return tree;
+}
+} // namespace
+
+std::vector<HostSnapshot> load_fleet(const std::vector<std::string>& files, unsigned workers)
+{
+	std::vector<HostSnapshot> hosts(files.size());
+	std::vector<std::string> errors(files.size());
+	parallel_for(files.size(), workers, [&](size_t i) {
+		hosts[i].host = files[i] == "-" ? "stdin" : std::filesystem::path(files[i]).stem().string();
+		try {
+			hosts[i].procs = parse_ps_snapshot(files[i]);
+		} catch (const std::exception& e) {
+			errors[i] = e.what();
+		}
+	});
+	for (const auto& error : errors)
+		if (!error.empty())
+			throw std::runtime_error(error);
+	return hosts;
+}
+
+FleetPlan plan_fleet(const std::vector<HostSnapshot>& hosts, size_t min_hosts)
+{
+	FleetPlan plan;
+	plan.fold_of.resize(hosts.size());
+	for (size_t h = 0; h < hosts.size(); ++h)
+		plan.fold_of[h].assign(hosts[h].procs.size(), FleetPlan::SHOWN);
+	if (min_hosts < 2)
+		return plan;
+
+	std::vector<HostTree> trees(hosts.size());
+	parallel_for(hosts.size(), 0, [&](size_t h) {
+		trees[h] = build_tree(hosts[h].procs);
+	});
+
+	// distinct hosts per subtree hash, hosts come in order so "last seen" dedups
+	struct Seen {
+		size_t last_host;
+		std::vector<size_t> hosts;
+	};
+	std::unordered_map<uint64_t, Seen> seen;
+	for (size_t h = 0; h < hosts.size(); ++h)
+		for (size_t node : trees[h].preorder) {
+			auto [it, inserted] = seen.try_emplace(trees[h].hash[node], Seen { h, { h } });
+			if (!inserted && it->second.last_host != h) {
+				it->second.last_host = h;
+				it->second.hosts.push_back(h);
+			}
+		}
+
+	// top-down, so only the largest shared subtree folds and its insides hide
+	std::unordered_map<uint64_t, long> fold_index;
+	for (size_t h = 0; h < hosts.size(); ++h) {
+		const HostTree& tree = trees[h];
+		std::vector<size_t> stack(tree.roots.rbegin(), tree.roots.rend());
+		while (!stack.empty()) {
+			const size_t node = stack.back();
+			stack.pop_back();
+			const Seen& shared = seen.at(tree.hash[node]);
+			if (shared.hosts.size() < min_hosts) {
+				for (size_t child : tree.children[node])
+					stack.push_back(child);
+				continue;
+			}
+			auto [it, inserted] = fold_index.try_emplace(tree.hash[node], static_cast<long>(plan.folds.size()));
+			if (inserted)
+				plan.folds.push_back({ h, node, 0, shared.hosts });
+			plan.fold_of[h][node] = it->second;
+			// hide the rest of the subtree, and count it for the first copy
+			std::vector<size_t> inside(tree.children[node]);
+			size_t size = 1;
+			while (!inside.empty()) {
+				const size_t below = inside.back();
+				inside.pop_back();
+				plan.fold_of[h][below] = FleetPlan::HIDDEN;
+				++size;
+				inside.insert(inside.end(), tree.children[below].begin(), tree.children[below].end());
+			}
+			if (inserted)
+				plan.folds.back().size = size;
+		}
+	}
+	return plan;
+}
@@ -0,0 +1,38 @@
+#ifndef PS2GV_FLEET_H
+#define PS2GV_FLEET_H
+#include "ps2gv/config-settings.h"
+#include "ps2gv/process-capture.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct HostSnapshot {
+	std::string host; // file stem
+	std::vector<ProcessInfo> procs;
+};
+
+// A process subtree that is the same (commands, units and shape, not pids or
+// usage) on several hosts, drawn once for all of them
+struct FoldedSubtree {
+	size_t host; // where the representative root lives
+	size_t proc;
+	size_t size; // processes in the subtree
+	std::vector<size_t> hosts; // every host running it, once each
+};
+
+struct FleetPlan {
+	static constexpr long SHOWN = -1;
+	static constexpr long HIDDEN = -2; // below a folded root
+	std::vector<FoldedSubtree> folds;
+	// per host, per process: SHOWN, HIDDEN, or the fold it is the root of
+	std::vector<std::vector<long>> fold_of;
+};
+
+// One snapshot per file, parsed over `workers` threads (0: one per core)
+std::vector<HostSnapshot> load_fleet(const std::vector<std::string>& files, unsigned workers);
+
+// Hash every subtree bottom-up (command, unit, sorted child hashes), then
+// fold the largest subtrees found on at least min_hosts hosts. min_hosts 0
+// or 1 folds nothing. Linear in the number of processes, plus the child sorts.
+FleetPlan plan_fleet(const std::vector<HostSnapshot>& hosts, size_t min_hosts);
+#endif // PS2GV_FLEET_H
@@ -1,11 +1,141 @@
 #include "ps2gv/graph-generator.h"
+#include "common/output.h"
 #include <algorithm>
 #include <graphviz/gvc.h>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 
-std::string generate_graph(const std::vector<ProcessInfo>& procs, const Config& config)
+struct ScaleRange {
+	const std::string& value;
+	float min_value;
+	float max_value;
+};
+
+static ScaleRange scale_for(const ProcessInfo& proc, const Config& config)
+{
+	switch (config.scale_mode) {
+	case ScaleMode::RSS:
+		return { proc.rss, config.min_rss_threshold, config.rss_limit };
+	case ScaleMode::IO:
+		return { proc.io_rate, config.min_io_threshold, config.io_limit };
+	case ScaleMode::PSS:
+		return { proc.pss, config.min_rss_threshold, config.rss_limit };
+	case ScaleMode::USS:
+		return { proc.uss, config.min_rss_threshold, config.rss_limit };
+	case ScaleMode::CPU:
+		break;
+	}
+	return { proc.pcpu, config.min_cpu_threshold, config.cpu_limit };
+}
+
+// DOT attributes (label, colour, size, tooltip) for a single process
+static std::string process_attributes(const ProcessInfo& proc, const Config& config, std::string& label_out, const std::string& extra_attrs = "", const std::string& extra_tooltip = "")
+{
+	// get command name
+	std::string comm = proc.command;
+	size_t last_slash = comm.find_last_of('/');
+	if (last_slash != std::string::npos)
+		comm = comm.substr(last_slash + 1);
+
+	// select colour based on unit, fallback to comm if unit is "-"
+	const std::string ckey = (proc.unit != "-" && !proc.unit.empty()) ? proc.unit : comm;
+	// "kworker/0:1" style names only make sense to rules as a whole
+	const std::string& colour = config.colour_for(ckey, ckey == comm && proc.command != comm ? proc.command : "");
+	const auto label = (ckey != comm) ? comm + "\n" + proc.unit : ckey;
+
+	// scale node size per configurable value
+	const auto scale = scale_for(proc, config);
+	float value = 0.0f;
+	try {
+		value = std::stof(scale.value);
+	} catch (...) {
+	}
+	std::string size_text;
+	if (value >= scale.min_value) {
+		float max_value = scale.max_value;
+		if (value > max_value)
+			value = max_value;
+		float ratio = value / max_value;
+		float width = config.base_width + config.width_factor * ratio;
+		float height = config.base_height + config.height_factor * ratio;
+		std::ostringstream size_stream;
+		size_stream << std::fixed << std::setprecision(2);
+		size_stream << "width=\"" << width << "\" height=\"" << height << "\"";
+		size_text = size_stream.str();
+	}
+
+	// tooltip for ps info in node
+	std::string tooltip = "PID: " + proc.pid + "\\nPPID: " + proc.ppid + "\\nCPU%: " + proc.pcpu + "\\nRSS: " + proc.rss + " KB" + "\\nCommand: " + comm + "\\nZone: " + proc.zone + "\\nUnit: " + proc.unit;
+	if (!proc.io_rate.empty())
+		tooltip += "\\nIO: " + proc.io_rate + " KB/s";
+	if (!proc.pss.empty())
+		tooltip += "\\nPSS: " + proc.pss + " KB\\nUSS: " + proc.uss + " KB";
+	tooltip += extra_tooltip;
+	// Sanitise for correct DOT syntax
+	std::replace(tooltip.begin(), tooltip.end(), '"', '\'');
+
+	label_out = label;
+	return "label=\"" + label + "\" "
+	    + "fillcolor=\"" + colour + "\" "
+	    + size_text
+	    + extra_attrs
+	    + "tooltip=\"" + tooltip + "\"";
+}
+
+// Thread names are whatever the program set, keep them from breaking out of a DOT string
+static std::string dot_safe(std::string s)
+{
+	std::replace(s.begin(), s.end(), '"', '\'');
+	std::replace(s.begin(), s.end(), '\\', '/');
+	return s;
+}
+
+static std::string thread_group_id(const ThreadGroup& group)
+{
+	return group.pid + ":" + dot_safe(group.comm);
+}
+
+// DOT attributes for a group of same-named threads, scaled by their CPU use
+static std::string thread_group_attributes(const ThreadGroup& group, const Config& config, std::string& label_out)
+{
+	const std::string comm = dot_safe(group.comm);
+	std::ostringstream attrs;
+	attrs << std::fixed << std::setprecision(2);
+	label_out = group.count > 1 ? comm + " x" + std::to_string(group.count) : comm;
+	attrs << "label=\"" << label_out << "\" shape=box style=\"filled,rounded\" "
+	      << "fillcolor=\"" << config.colour_for(group.comm) << "\" ";
+	if (group.pcpu >= config.min_cpu_threshold) {
+		const float ratio = std::min(group.pcpu, config.cpu_limit) / config.cpu_limit;
+		attrs << "width=\"" << config.base_width + config.width_factor * ratio << "\" "
+		      << "height=\"" << config.base_height + config.height_factor * ratio << "\" ";
+	}
+	attrs << std::setprecision(1) << "tooltip=\"Threads: " << group.count << "\\nName: " << comm
+	      << "\\nCPU%: " << group.pcpu << " (sampled)\\nTIDs:";
+	constexpr size_t shown_tids = 16;
+	for (size_t i = 0; i < std::min(group.tids.size(), shown_tids); ++i)
+		attrs << " " << group.tids[i];
+	if (group.tids.size() > shown_tids)
+		attrs << " ...";
+	attrs << "\"";
+	return attrs.str();
+}
+
+// Emit the edge to the parent and the styled node for a single process
+static void emit_process(std::ostream& dot_stream, const ProcessInfo& proc, const Config& config, const std::string& extra_attrs = "", const std::string& extra_tooltip = "")
+{
+	std::string label;
+	const auto attributes = process_attributes(proc, config, label, extra_attrs, extra_tooltip);
+
+	// Add edge & node
+	dot_stream << "  \"" << proc.ppid << "\" -> \"" << proc.pid << "\";\n";
+	dot_stream << "  \"" << proc.pid << "\" [" << attributes << "];\n";
+}
+
+std::string generate_graph(const std::vector<ProcessInfo>& procs, const Config& config, const std::vector<ThreadGroup>& threads, const std::vector<IpcLink>& ipc)
 {
 	std::stringstream dot_stream;
 	dot_stream << "digraph ptree {\n";
@@ -15,61 +145,188 @@ std::string generate_graph(const std::vector<ProcessInfo>& procs, const Config&
 		// skip invalid PIDs
 		if (proc.pid.empty() || !std::isdigit(proc.pid[0]))
 			continue;
+		emit_process(dot_stream, proc, config);
+	}
+	for (const auto& group : threads) {
+		std::string label;
+		const auto id = thread_group_id(group);
+		dot_stream << "  \"" << group.pid << "\" -> \"" << id << "\" [style=dashed];\n";
+		dot_stream << "  \"" << id << "\" [" << thread_group_attributes(group, config, label) << "];\n";
+	}
+	// who talks to whom, next to who forked whom, without pulling the tree around
+	for (const auto& link : ipc) {
+		const char* colour = link.kind == "pipe" ? "steelblue" : link.kind == "unix" ? "darkorchid" : "darkorange";
+		dot_stream << "  \"" << link.from << "\" -> \"" << link.to << "\" [dir=none style=dashed constraint=false color=" << colour
+			   << " penwidth=" << std::min<size_t>(1 + link.shared / 4, 4) << " tooltip=\"" << link.kind << ": " << link.shared << " shared";
+		if (!link.detail.empty())
+			dot_stream << "\\n" << dot_safe(link.detail);
+		dot_stream << "\"];\n";
+	}
 
-		// get command name
-		std::string comm = proc.command;
-		size_t last_slash = comm.find_last_of('/');
-		if (last_slash != std::string::npos)
-			comm = comm.substr(last_slash + 1);
-
-		// select colour based on unit, fallback to comm if unit is "-"
-		const std::string ckey = (proc.unit != "-" && !proc.unit.empty()) ? proc.unit : comm;
-		const auto& colour_it = config.command_colours.find(ckey);
-		const std::string& colour = (colour_it != config.command_colours.end()) ? colour_it->second : config.command_colours.at("default");
-		const auto label = (ckey != comm) ? comm + "\n" + proc.unit : ckey;
-
-		// scale node size per configurable value
-		float value = 0.0f;
-		try {
-			value = std::stof(config.scale_mode == ScaleMode::CPU ? proc.pcpu : proc.rss);
-		} catch (...) {
-		}
-		std::string size_text;
-		if (value >= (config.scale_mode == ScaleMode::CPU ? config.min_cpu_threshold : config.min_rss_threshold)) {
-			float max_value = (config.scale_mode == ScaleMode::CPU ? config.cpu_limit : config.rss_limit);
-			if (value > max_value)
-				value = max_value;
-			float ratio = value / max_value;
-			float width = config.base_width + config.width_factor * ratio;
-			float height = config.base_height + config.height_factor * ratio;
-			std::ostringstream size_stream;
-			size_stream << std::fixed << std::setprecision(2);
-			size_stream << "width=\"" << width << "\" height=\"" << height << "\"";
-			size_text = size_stream.str();
+	dot_stream << "}\n";
+	return dot_stream.str();
+}
+
+std::vector<TreeNode> build_process_tree(const std::vector<ProcessInfo>& procs, const Config& config, const std::vector<ThreadGroup>& threads)
+{
+	std::vector<TreeNode> nodes;
+	nodes.reserve(procs.size());
+	std::unordered_map<std::string, long> index_of;
+	for (const auto& proc : procs) {
+		if (proc.pid.empty() || !std::isdigit(proc.pid[0]))
+			continue;
+		TreeNode node;
+		node.id = proc.pid;
+		node.attributes = process_attributes(proc, config, node.label);
+		index_of.emplace(proc.pid, static_cast<long>(nodes.size()));
+		nodes.push_back(std::move(node));
+	}
+	// parents can come after their children, link in a second pass
+	size_t i = 0;
+	for (const auto& proc : procs) {
+		if (proc.pid.empty() || !std::isdigit(proc.pid[0]))
+			continue;
+		const auto parent = index_of.find(proc.ppid);
+		if (parent != index_of.end())
+			nodes[i].parent = parent->second;
+		++i;
+	}
+	for (const auto& group : threads) {
+		const auto parent = index_of.find(group.pid);
+		if (parent == index_of.end())
+			continue;
+		TreeNode node;
+		node.id = thread_group_id(group);
+		node.attributes = thread_group_attributes(group, config, node.label);
+		node.parent = parent->second;
+		nodes.push_back(std::move(node));
+	}
+	return nodes;
+}
+
+std::string generate_diff_graph(const std::vector<DiffEntry>& entries, const Config& config)
+{
+	std::stringstream dot_stream;
+	dot_stream << "digraph ptree_diff {\n";
+	dot_stream << "node [style=filled];\n";
+
+	for (const auto& entry : entries) {
+		std::ostringstream attrs;
+		std::ostringstream tooltip;
+		tooltip << std::fixed << std::setprecision(1);
+		switch (entry.diff_class) {
+		case DiffClass::New:
+			attrs << " color=\"" << config.diff_new_colour << "\" penwidth=3 style=\"filled,bold\" ";
+			tooltip << "\\nDiff: new";
+			break;
+		case DiffClass::Exited:
+			attrs << " color=\"" << config.diff_exited_colour << "\" penwidth=3 style=\"filled,dashed\" fontcolor=\"gray40\" ";
+			tooltip << "\\nDiff: exited";
+			break;
+		case DiffClass::Changed:
+			attrs << " color=\"" << config.diff_changed_colour << "\" penwidth=3 ";
+			tooltip << "\\nDiff: changed"
+				<< "\\nRSS delta: " << std::showpos << entry.rss_delta << " KB"
+				<< "\\nCPU% delta: " << entry.cpu_delta;
+			break;
+		case DiffClass::Unchanged: // ancestors only give context
+			attrs << " color=\"gray60\" fontcolor=\"gray40\" ";
+			break;
 		}
+		emit_process(dot_stream, entry.proc, config, attrs.str(), tooltip.str());
+	}
 
-		// tooltip for ps info in node
-		std::string tooltip = "PID: " + proc.pid + "\\nPPID: " + proc.ppid + "\\nCPU%: " + proc.pcpu + "\\nRSS: " + proc.rss + " KB" + "\\nCommand: " + comm + "\\nZone: " + proc.zone + "\\nUnit: " + proc.unit;
-		// Sanitise for correct DOT syntax
-		std::replace(tooltip.begin(), tooltip.end(), '"', '\'');
+	dot_stream << "}\n";
+	return dot_stream.str();
+}
 
-		// Add edge & node
-		dot_stream << "  \"" << proc.ppid << "\" -> \"" << proc.pid << "\";\n";
-		dot_stream << "  \"" << proc.pid << "\" ["
-			   << "label=\"" << label << "\" "
-			   << "fillcolor=\"" << colour << "\" "
-			   << size_text
-			   << "tooltip=\"" << tooltip << "\""
-			   << "];\n";
+std::string generate_fleet_graph(const std::vector<HostSnapshot>& hosts, const FleetPlan& plan, const Config& config)
+{
+	std::stringstream dot_stream;
+	dot_stream << "digraph fleet {\n";
+	dot_stream << "node [style=filled];\n";
+	dot_stream << "compound=true;\n";
+
+	// pids repeat across hosts, node ids carry the host index
+	auto node_id = [](size_t host, const std::string& pid) {
+		return "h" + std::to_string(host) + "/" + pid;
+	};
+	std::unordered_set<std::string> fold_edges; // parent -> fold, once each
+	std::stringstream outside;
+	for (size_t h = 0; h < hosts.size(); ++h) {
+		const auto& procs = hosts[h].procs;
+		const std::string anchor = "h" + std::to_string(h);
+		std::unordered_set<std::string> pids;
+		for (const auto& proc : procs)
+			pids.insert(proc.pid);
+
+		dot_stream << "  subgraph \"cluster_" << h << "\" {\n";
+		dot_stream << "    label=\"" << dot_safe(hosts[h].host) << "\"; style=rounded;\n";
+		dot_stream << "    \"" << anchor << "\" [label=\"" << dot_safe(hosts[h].host) << "\" shape=box3d fillcolor=white];\n";
+		for (size_t i = 0; i < procs.size(); ++i) {
+			const auto& proc = procs[i];
+			const long fold = plan.fold_of[h][i];
+			if (proc.pid.empty() || !std::isdigit(proc.pid[0]) || fold == FleetPlan::HIDDEN)
+				continue;
+			// top-level processes hang off the host
+			const std::string parent = pids.count(proc.ppid) && proc.ppid != proc.pid ? node_id(h, proc.ppid) : anchor;
+			if (fold >= 0) {
+				const std::string edge = "  \"" + parent + "\" -> \"fold/" + std::to_string(fold) + "\";\n";
+				if (fold_edges.insert(edge).second)
+					outside << edge;
+				continue;
+			}
+			std::string label;
+			dot_stream << "    \"" << parent << "\" -> \"" << node_id(h, proc.pid) << "\";\n";
+			dot_stream << "    \"" << node_id(h, proc.pid) << "\" [" << process_attributes(proc, config, label) << "];\n";
+		}
+		dot_stream << "  }\n";
+	}
+
+	for (size_t f = 0; f < plan.folds.size(); ++f) {
+		const auto& fold = plan.folds[f];
+		const auto& proc = hosts[fold.host].procs[fold.proc];
+		std::string label;
+		process_attributes(proc, config, label);
+		std::ostringstream attrs, tooltip;
+		attrs << " label=\"" << label << "\\n" << fold.size << (fold.size == 1 ? " process" : " processes")
+		      << " on " << fold.hosts.size() << " hosts\" peripheries=2 ";
+		tooltip << "\\nHosts:";
+		constexpr size_t shown_hosts = 32;
+		for (size_t i = 0; i < std::min(fold.hosts.size(), shown_hosts); ++i)
+			tooltip << " " << dot_safe(hosts[fold.hosts[i]].host);
+		if (fold.hosts.size() > shown_hosts)
+			tooltip << " ...";
+		dot_stream << "  \"fold/" << f << "\" [" << process_attributes(proc, config, label, attrs.str(), tooltip.str()) << "];\n";
 	}
+	dot_stream << outside.str();
 
 	dot_stream << "}\n";
 	return dot_stream.str();
 }
 
-void render_graph(const std::string& dot_graph, const std::string& output_file)
+void render_graph(const std::string& dot_graph, const std::string& output_file, const RenderOptions& options)
 {
+	// stdout carries the graph itself, the chatter goes elsewhere
+	std::ostream& log = output_file == STDIO_PATH ? std::cerr : std::cout;
+	const std::string target = output_file == STDIO_PATH ? "stdout" : output_file;
 	GVC_t* gvc = gvContext();
+	// the DOT already carries everything from the input and the config
+	std::string cache_key;
+	if (options.cache) {
+		const char* graphviz = gvcVersion(gvc);
+		cache_key = ContentHash().add(RENDER_CACHE_VERSION).add("ps2gv").add(graphviz ? graphviz : "").add(options.layout.engine).add(options.layout.timeout_ms).add(options.format).add(dot_graph).hex();
+		std::string cached;
+		if (options.cache->load(cache_key, cached)) {
+			gvFreeContext(gvc);
+			if (!write_output(cached, output_file))
+				std::cerr << "Error: Failed to write " << target << std::endl;
+			else
+				log << "Successfully rendered graph to " << target << " (cached)" << std::endl;
+			return;
+		}
+	}
+
 	Agraph_t* g = agmemread(const_cast<char*>(dot_graph.c_str()));
 	if (!g) {
 		std::cerr << "Error: Failed to parse DOT graph" << std::endl;
@@ -77,19 +334,34 @@ void render_graph(const std::string& dot_graph, const std::string& output_file)
 		return;
 	}
 
-	if (gvLayout(gvc, g, "fdp") != 0) {
+	std::string rendered;
+	LayoutReport report;
+	if (!layout_render(gvc, g, options.format, options.layout, rendered, report)) {
 		std::cerr << "Error: Failed to layout graph" << std::endl;
-		agclose(g);
-		gvFreeContext(gvc);
-		return;
-	}
-
-	if (gvRenderFilename(gvc, g, "svg", output_file.c_str()) != 0)
+	} else if (!write_output(rendered, output_file)) {
 		std::cerr << "Error: Failed to render graph" << std::endl;
-	else
-		std::cout << "Successfully rendered graph to " << output_file << std::endl;
+	} else {
+		log << "Successfully rendered graph to " << target << " " << describe(report) << std::endl;
+		// a fallback is this run's luck, the next one may get the engine asked for
+		if (options.cache && report.abandoned.empty())
+			options.cache->store(cache_key, rendered);
+	}
 
-	gvFreeLayout(gvc, g);
 	agclose(g);
 	gvFreeContext(gvc);
 }
+
+std::vector<std::string> render_graph_data(GVC_t* gvc, const std::string& dot_graph, const std::vector<std::string>& formats, const LayoutOptions& layout, LayoutReport& report)
+{
+	Agraph_t* g = agmemread(const_cast<char*>(dot_graph.c_str()));
+	if (!g)
+		throw std::runtime_error("Failed to parse DOT graph");
+
+	// one layout, many renders
+	std::vector<std::string> outputs;
+	const bool ok = layout_render(gvc, g, formats, layout, outputs, report);
+	agclose(g);
+	if (!ok)
+		throw std::runtime_error("Failed to layout graph");
+	return outputs;
+}
@@ -1,8 +1,34 @@
 #ifndef PS2GV_GENERATOR_H
 #define PS2GV_GENERATOR_H
+#include "common/layout.h"
+#include "common/render-cache.h"
+#include "common/tiling.h"
 #include "ps2gv/config-settings.h"
+#include "ps2gv/fleet-merge.h"
+#include "ps2gv/process-ipc.h"
 #include "ps2gv/process-capture.h"
+#include "ps2gv/process-threads.h"
+#include "ps2gv/snapshot-diff.h"
+#include <graphviz/gvc.h>
 
-std::string generate_graph(const std::vector<ProcessInfo>& procs, const Config& cfg);
-void render_graph(const std::string& dot_graph, const std::string& output_path);
+// `threads` hang off their process as one node per thread name
+std::string generate_graph(const std::vector<ProcessInfo>& procs, const Config& cfg, const std::vector<ThreadGroup>& threads = {}, const std::vector<IpcLink>& ipc = {});
+// Same nodes as generate_graph(), as a tree for render_tiled()
+std::vector<TreeNode> build_process_tree(const std::vector<ProcessInfo>& procs, const Config& cfg, const std::vector<ThreadGroup>& threads = {});
+std::string generate_diff_graph(const std::vector<DiffEntry>& entries, const Config& cfg);
+// One cluster per host, folded subtrees drawn once outside the clusters
+std::string generate_fleet_graph(const std::vector<HostSnapshot>& hosts, const FleetPlan& plan, const Config& cfg);
+struct RenderOptions {
+	std::string format = "svg";
+	LayoutOptions layout; // engine, time budget
+	const RenderCache* cache = nullptr;
+};
+
+// output_path "-" writes to stdout. With a cache, a graph rendered before
+// (same DOT, layout options, format and Graphviz) is copied out instead of
+// laid out again.
+void render_graph(const std::string& dot_graph, const std::string& output_path, const RenderOptions& options = {});
+// Lay out once with a caller-owned context and render each format into
+// memory, within layout's time budget like render_graph()
+std::vector<std::string> render_graph_data(GVC_t* gvc, const std::string& dot_graph, const std::vector<std::string>& formats, const LayoutOptions& layout, LayoutReport& report);
 #endif // PS2GV_GENERATOR_H
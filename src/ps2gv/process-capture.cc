@@ -8,6 +8,23 @@
 #include <unistd.h>
 #include <vector>
 
+std::string read_systemd_unit(const std::string& pid)
+{
+	// Get systemd unit from /proc fs
+	std::string cgroup_path = "/proc/" + pid + "/cgroup";
+	std::ifstream cgroup_file(cgroup_path);
+	std::string cgroup_content((std::istreambuf_iterator<char>(cgroup_file)), std::istreambuf_iterator<char>());
+	// Match the last .service/.scope/.timer/etc which is the most specific unit for that PID
+	// std::regex unit_re(R"(([^/\n]+\.(service|scope|timer|socket|mount)))"); // TODO: This was too verbose, add an option to enable how much translation
+	static const std::regex unit_re(R"(([^/\n]+\.(service|timer)))");
+	std::string last_unit;
+	auto begin = std::sregex_iterator(cgroup_content.begin(), cgroup_content.end(), unit_re);
+	auto end = std::sregex_iterator();
+	for (auto it = begin; it != end; ++it)
+		last_unit = (*it)[1].str();
+	return last_unit.empty() ? "-" : last_unit;
+}
+
 std::vector<ProcessInfo> capture_live()
 {
 	int pipefd[2];
@@ -70,20 +87,7 @@ std::vector<ProcessInfo> capture_live()
 			info.unit = "-"; // MacOS ps's shows the full command name, so no need to translate to the service name.
 		} else { // Linux: ZONE PPID PID RSS PCPU COMM
 			linestream >> info.zone >> info.ppid >> info.pid >> info.rss >> info.pcpu >> info.command;
-			// Get systemd unit from /proc fs
-			std::string cgroup_path = "/proc/" + info.pid + "/cgroup";
-			std::ifstream cgroup_file(cgroup_path);
-			std::string cgroup_content((std::istreambuf_iterator<char>(cgroup_file)), std::istreambuf_iterator<char>());
-			// Match the last .service/.scope/.timer/etc which is the most specific unit for that PID
-			// std::regex unit_re(R"(([^/\n]+\.(service|scope|timer|socket|mount)))"); // TODO: This was too verbose, add an option to enable how much translation
-			std::regex unit_re(R"(([^/\n]+\.(service|timer)))");
-			std::smatch match;
-			std::string last_unit;
-			auto begin = std::sregex_iterator(cgroup_content.begin(), cgroup_content.end(), unit_re);
-			auto end = std::sregex_iterator();
-			for (auto it = begin; it != end; ++it)
-				last_unit = (*it)[1].str();
-			info.unit = last_unit.empty() ? "-" : last_unit;
+			info.unit = read_systemd_unit(info.pid);
 		}
 		procs.push_back(info);
 	}
@@ -101,10 +105,16 @@ PSFormat detect_format(const std::string& first_line)
 
 std::vector<ProcessInfo> parse_ps_snapshot(const std::string& filename)
 {
+	if (filename == "-")
+		return parse_ps_snapshot(std::cin);
 	std::ifstream file(filename);
 	if (!file)
 		throw std::runtime_error("Cannot open ps snapshot file: " + filename);
+	return parse_ps_snapshot(file);
+}
 
+std::vector<ProcessInfo> parse_ps_snapshot(std::istream& file)
+{
 	std::vector<ProcessInfo> procs;
 	std::string line;
 
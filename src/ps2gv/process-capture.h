@@ -1,5 +1,6 @@
 #ifndef PS2GV_CAPTURE_H
 #define PS2GV_CAPTURE_H
+#include <istream>
 #include <string>
 #include <vector>
 
@@ -17,9 +18,18 @@ struct ProcessInfo {
 	std::string pcpu;
 	std::string command;
 	std::string unit; // systemd unit if available
+	// only filled in by sample_process_detail() for the scale modes that need them
+	std::string io_rate; // KB/s
+	std::string pss; // KB
+	std::string uss; // KB
 };
 
 std::vector<ProcessInfo> capture_live();
+// Most specific systemd .service/.timer unit from /proc/<pid>/cgroup, "-" if none
+std::string read_systemd_unit(const std::string& pid);
+// "-" reads the snapshot from stdin
 std::vector<ProcessInfo> parse_ps_snapshot(const std::string& filename);
+// Same, from an already open stream (ps output in a buffer, a pipe, ...)
+std::vector<ProcessInfo> parse_ps_snapshot(std::istream& in);
 PSFormat detect_format(const std::string& first_line);
 #endif // PS2GV_CAPTURE_H
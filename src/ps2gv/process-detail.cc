@@ -0,0 +1,119 @@
+#include "ps2gv/process-detail.h"
+#include "common/parallel-for.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+namespace {
+// storage I/O actually caused by the process, in bytes
+bool read_io_bytes(const std::string& pid, uint64_t& total)
+{
+	std::ifstream file("/proc/" + pid + "/io");
+	if (!file)
+		return false; // gone, or not ours to look at
+	std::string key;
+	uint64_t value;
+	bool found = false;
+	total = 0;
+	while (file >> key >> value) {
+		if (key == "read_bytes:" || key == "write_bytes:") {
+			total += value;
+			found = true;
+		}
+	}
+	return found;
+}
+
+// in KB, as reported by the kernel
+bool read_smaps_rollup(const std::string& pid, uint64_t& pss, uint64_t& uss)
+{
+	std::ifstream file("/proc/" + pid + "/smaps_rollup");
+	if (!file)
+		return false;
+	std::string line;
+	bool found = false;
+	pss = uss = 0;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string key;
+		uint64_t kb = 0;
+		if (!(fields >> key >> kb))
+			continue;
+		if (key == "Pss:") {
+			pss = kb;
+			found = true;
+		} else if (key == "Private_Clean:" || key == "Private_Dirty:" || key == "Private_Hugetlb:") {
+			uss += kb;
+		}
+	}
+	return found;
+}
+
+float to_float(const std::string& s)
+{
+	try {
+		return std::stof(s);
+	} catch (...) {
+		return 0.0f;
+	}
+}
+
+void sample_io(std::vector<ProcessInfo>& procs, const Config& config)
+{
+	std::vector<uint64_t> first(procs.size()), second(procs.size());
+	std::vector<char> ok(procs.size(), 0);
+	const auto started = std::chrono::steady_clock::now();
+	parallel_for(procs.size(), config.detail_workers, [&](size_t i) {
+		ok[i] = read_io_bytes(procs[i].pid, first[i]);
+	});
+	std::this_thread::sleep_until(started + std::chrono::milliseconds(config.io_sample_interval_ms));
+	const auto elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - started).count();
+	parallel_for(procs.size(), config.detail_workers, [&](size_t i) {
+		if (ok[i] && read_io_bytes(procs[i].pid, second[i]) && second[i] >= first[i])
+			procs[i].io_rate = std::to_string(static_cast<uint64_t>((second[i] - first[i]) / 1024.0f / elapsed));
+	});
+}
+
+void sample_memory(std::vector<ProcessInfo>& procs, const Config& config)
+{
+	// cheap pre-filter, smaps_rollup is anything but cheap
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < procs.size(); ++i)
+		if (to_float(procs[i].rss) >= config.detail_min_rss)
+			candidates.push_back(i);
+
+	parallel_for(candidates.size(), config.detail_workers, [&](size_t c) {
+		ProcessInfo& proc = procs[candidates[c]];
+		uint64_t pss, uss;
+		if (read_smaps_rollup(proc.pid, pss, uss)) {
+			proc.pss = std::to_string(pss);
+			proc.uss = std::to_string(uss);
+		}
+	});
+}
+} // namespace
+#endif
+
+bool needs_process_detail(ScaleMode mode)
+{
+	return mode == ScaleMode::IO || mode == ScaleMode::PSS || mode == ScaleMode::USS;
+}
+
+void sample_process_detail(std::vector<ProcessInfo>& procs, const Config& config)
+{
+	if (!needs_process_detail(config.scale_mode))
+		return;
+#ifdef __linux__
+	if (config.scale_mode == ScaleMode::IO)
+		sample_io(procs, config);
+	else
+		sample_memory(procs, config);
+#else
+	(void)procs;
+	std::cerr << "Warning: io/pss/uss scale modes need Linux /proc, nodes will not be scaled.\n";
+#endif
+}
@@ -0,0 +1,16 @@
+#ifndef PS2GV_DETAIL_H
+#define PS2GV_DETAIL_H
+#include "ps2gv/config-settings.h"
+#include "ps2gv/process-capture.h"
+#include <vector>
+
+// True for scale modes that need more than what ps reports
+bool needs_process_detail(ScaleMode mode);
+
+// Fill in the columns the configured scale mode needs, Linux /proc only:
+//  - IO: read+write rate from /proc/<pid>/io, sampled over io_sample_interval_ms
+//  - PSS/USS: from /proc/<pid>/smaps_rollup, only for processes whose RSS is at
+//    least detail_min_rss since the kernel walks page tables to produce it
+// Reads are spread over detail_workers threads.
+void sample_process_detail(std::vector<ProcessInfo>& procs, const Config& config);
+#endif // PS2GV_DETAIL_H
@@ -0,0 +1,337 @@
+#include "ps2gv/process-events.h"
+#include "common/parallel-for.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+#ifdef __linux__
+namespace {
+struct ProcClock {
+	double uptime = 0.0; // seconds
+	double ticks = 100.0; // per second
+	long page_kb = 4;
+
+	static ProcClock now()
+	{
+		ProcClock clock;
+		std::ifstream("/proc/uptime") >> clock.uptime;
+		clock.ticks = static_cast<double>(sysconf(_SC_CLK_TCK));
+		clock.page_kb = sysconf(_SC_PAGESIZE) / 1024;
+		return clock;
+	}
+};
+
+// The columns ps would report, from /proc/<pid>/stat: ppid, rss and %cpu
+// (cpu time over lifetime, like ps). `with_identity` also refreshes command,
+// zone and unit, which only change on exec.
+bool read_proc(ProcessInfo& info, const ProcClock& clock, bool with_identity)
+{
+	std::ifstream file("/proc/" + info.pid + "/stat");
+	std::string stat;
+	if (!std::getline(file, stat))
+		return false;
+	// comm can hold spaces and parens, the other fields resume after the last ')'
+	const size_t open = stat.find('(');
+	const size_t close = stat.rfind(')');
+	if (open == std::string::npos || close == std::string::npos || close < open || close + 2 > stat.size())
+		return false;
+
+	std::istringstream fields(stat.substr(close + 2));
+	std::string state;
+	long long ppid, skip, utime, stime, starttime, rss_pages;
+	fields >> state >> ppid;
+	for (int i = 0; i < 9; ++i) // pgrp .. cmajflt
+		fields >> skip;
+	fields >> utime >> stime;
+	for (int i = 0; i < 6; ++i) // cutime .. itrealvalue
+		fields >> skip;
+	fields >> starttime >> skip >> rss_pages; // vsize in between
+	if (!fields)
+		return false;
+
+	const double elapsed = clock.uptime - starttime / clock.ticks;
+	const double pcpu = elapsed > 0.0 ? (utime + stime) / clock.ticks / elapsed * 100.0 : 0.0;
+	char pcpu_text[16];
+	std::snprintf(pcpu_text, sizeof(pcpu_text), "%.1f", pcpu);
+	info.ppid = std::to_string(ppid);
+	info.rss = std::to_string(rss_pages * clock.page_kb);
+	info.pcpu = pcpu_text;
+
+	if (with_identity) {
+		info.command = stat.substr(open + 1, close - open - 1);
+		// ps reports the security label as "zone" on Linux
+		std::ifstream label_file("/proc/" + info.pid + "/attr/current");
+		std::string label;
+		std::getline(label_file, label, '\0');
+		label.erase(label.find_last_not_of("\n") + 1);
+		info.zone = label.empty() ? "-" : label;
+		info.unit = read_systemd_unit(info.pid);
+	}
+	return true;
+}
+
+// read straight away on exec, short-lived processes are gone by refresh time
+void read_comm(ProcessInfo& info)
+{
+	std::ifstream file("/proc/" + info.pid + "/comm");
+	std::string comm;
+	if (std::getline(file, comm) && !comm.empty())
+		info.command = comm;
+}
+
+// worth re-reading every sample for the current scale mode
+bool interesting(const ProcessInfo& info, const Config& config)
+{
+	try {
+		if (config.scale_mode == ScaleMode::CPU)
+			return std::stof(info.pcpu) >= config.min_cpu_threshold;
+		return std::stof(info.rss) >= config.min_rss_threshold;
+	} catch (...) {
+		return true;
+	}
+}
+// The kernel answers LISTEN with a PROC_EVENT_NONE carrying an errno. In a
+// container the send goes through and then nothing: no ack means no events.
+// Events arriving before the ack are dropped, the seeding rescan has them.
+bool listen_acked(int fd)
+{
+	constexpr auto ACK_TIMEOUT = std::chrono::milliseconds(250);
+	const auto deadline = std::chrono::steady_clock::now() + ACK_TIMEOUT;
+	alignas(struct nlmsghdr) char buffer[4096];
+	while (true) {
+		const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		struct pollfd pfd { fd, POLLIN, 0 };
+		if (remaining <= 0 || poll(&pfd, 1, static_cast<int>(remaining)) <= 0)
+			return false;
+		const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+		if (received < 0 && (errno == EINTR || errno == ENOBUFS))
+			continue;
+		if (received <= 0)
+			return false;
+		int length = static_cast<int>(received);
+		for (auto* header = reinterpret_cast<struct nlmsghdr*>(buffer); NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+			if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP)
+				continue;
+			const auto* message = static_cast<const struct cn_msg*>(NLMSG_DATA(header));
+			if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC)
+				continue;
+			const auto* event = reinterpret_cast<const struct proc_event*>(message->data);
+			if (event->what == proc_event::PROC_EVENT_NONE)
+				return event->event_data.ack.err == 0;
+		}
+	}
+}
+} // namespace
+#endif
+
+ProcessMonitor::ProcessMonitor(const Config& config)
+    : config_(config)
+{
+	// subscribe before seeding, so nothing falls in between
+	if (subscribe())
+		rescan();
+}
+
+ProcessMonitor::~ProcessMonitor()
+{
+	if (socket_fd_ >= 0)
+		close(socket_fd_);
+}
+
+bool ProcessMonitor::subscribe()
+{
+#ifdef __linux__
+	const int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if (fd < 0)
+		return false;
+	struct sockaddr_nl addr {};
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+		close(fd);
+		return false;
+	}
+
+	// netlink header + connector header + "start listening"
+	alignas(struct nlmsghdr) char request[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))] {};
+	auto* header = reinterpret_cast<struct nlmsghdr*>(request);
+	header->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+	header->nlmsg_type = NLMSG_DONE;
+	header->nlmsg_pid = 0;
+	auto* message = static_cast<struct cn_msg*>(NLMSG_DATA(header));
+	message->id.idx = CN_IDX_PROC;
+	message->id.val = CN_VAL_PROC;
+	message->len = sizeof(enum proc_cn_mcast_op);
+	const enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+	std::memcpy(message->data, &op, sizeof(op));
+	if (send(fd, request, header->nlmsg_len, 0) < 0 || !listen_acked(fd)) {
+		close(fd);
+		return false;
+	}
+	socket_fd_ = fd;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ProcessMonitor::rescan()
+{
+#ifdef __linux__
+	// known pids keep their entries, refresh() finds the ones gone since
+	if (DIR* proc = opendir("/proc")) {
+		while (const struct dirent* entry = readdir(proc)) {
+			char* end = nullptr;
+			const long pid = std::strtol(entry->d_name, &end, 10);
+			if (*end != '\0' || pid <= 0)
+				continue;
+			Entry& e = table_[static_cast<int32_t>(pid)];
+			e.info.pid = entry->d_name;
+		}
+		closedir(proc);
+	}
+	refresh(true);
+#endif
+}
+
+void ProcessMonitor::drain(std::chrono::steady_clock::time_point deadline)
+{
+#ifdef __linux__
+	bool overrun = false;
+	alignas(struct nlmsghdr) char buffer[16 * 1024];
+	while (true) {
+		const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		struct pollfd pfd { socket_fd_, POLLIN, 0 };
+		if (poll(&pfd, 1, static_cast<int>(std::max<long long>(0, remaining))) <= 0)
+			break; // window is over (or interrupted, same thing)
+		const ssize_t received = recv(socket_fd_, buffer, sizeof(buffer), 0);
+		if (received < 0) {
+			if (errno == ENOBUFS) // the kernel dropped events on us
+				overrun = true;
+			if (errno == ENOBUFS || errno == EINTR)
+				continue;
+			break;
+		}
+
+		int length = static_cast<int>(received);
+		for (auto* header = reinterpret_cast<struct nlmsghdr*>(buffer); NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+			if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP)
+				continue;
+			const auto* message = static_cast<const struct cn_msg*>(NLMSG_DATA(header));
+			if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC)
+				continue;
+			const auto* event = reinterpret_cast<const struct proc_event*>(message->data);
+			switch (event->what) {
+			case proc_event::PROC_EVENT_FORK: {
+				const auto& fork = event->event_data.fork;
+				if (fork.child_pid != fork.child_tgid)
+					break; // a new thread, not a new process
+				Entry child;
+				const auto parent = table_.find(fork.parent_tgid);
+				if (parent != table_.end()) {
+					// same command until it execs, but its own columns stay empty
+					// until refresh() reads them, a child gone by then is not scaled
+					child.info.zone = parent->second.info.zone;
+					child.info.command = parent->second.info.command;
+					child.info.unit = parent->second.info.unit;
+				}
+				child.info.pid = std::to_string(fork.child_tgid);
+				child.info.ppid = std::to_string(fork.parent_tgid);
+				table_[fork.child_tgid] = std::move(child);
+				break;
+			}
+			case proc_event::PROC_EVENT_EXEC:
+			case proc_event::PROC_EVENT_COMM: {
+				const int32_t tgid = event->what == proc_event::PROC_EVENT_EXEC ? event->event_data.exec.process_tgid : event->event_data.comm.process_tgid;
+				Entry& entry = table_[tgid];
+				entry.info.pid = std::to_string(tgid);
+				entry.dirty = true;
+				read_comm(entry.info);
+				break;
+			}
+			case proc_event::PROC_EVENT_EXIT: {
+				const auto& exit = event->event_data.exit;
+				if (exit.process_pid != exit.process_tgid)
+					break;
+				const auto it = table_.find(exit.process_tgid);
+				if (it != table_.end())
+					it->second.exited = true;
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+	if (overrun)
+		rescan();
+#else
+	(void)deadline;
+#endif
+}
+
+void ProcessMonitor::refresh(bool full)
+{
+#ifdef __linux__
+	std::vector<Entry*> stale;
+	for (auto& [pid, entry] : table_) {
+		if (entry.info.pid.empty())
+			entry.info.pid = std::to_string(pid); // exec/comm for a pid we never saw fork
+		if (!entry.exited && (full || entry.dirty || interesting(entry.info, config_)))
+			stale.push_back(&entry);
+	}
+
+	const ProcClock clock = ProcClock::now();
+	parallel_for(stale.size(), config_.detail_workers, [&](size_t i) {
+		Entry& entry = *stale[i];
+		if (read_proc(entry.info, clock, entry.dirty || entry.info.command.empty()))
+			entry.dirty = false;
+		else
+			entry.exited = true; // gone, and we missed the exit event
+	});
+#else
+	(void)full;
+#endif
+}
+
+std::vector<ProcessInfo> ProcessMonitor::sample(std::chrono::milliseconds window)
+{
+	if (!event_driven())
+		return capture_live();
+
+	drain(std::chrono::steady_clock::now() + window);
+	// a full refresh also picks up pids whose fork event we never got
+	if (config_.event_full_refresh > 0 && ++samples_ % config_.event_full_refresh == 0)
+		rescan();
+	else
+		refresh(false);
+
+	// same order as ps, and short-lived processes get reported exactly once
+	std::vector<int32_t> pids;
+	pids.reserve(table_.size());
+	for (const auto& [pid, entry] : table_)
+		if (!entry.info.command.empty())
+			pids.push_back(pid);
+	std::sort(pids.begin(), pids.end());
+
+	std::vector<ProcessInfo> procs;
+	procs.reserve(pids.size());
+	for (const int32_t pid : pids)
+		procs.push_back(table_[pid].info);
+	for (auto it = table_.begin(); it != table_.end();)
+		it = it->second.exited ? table_.erase(it) : std::next(it);
+	return procs;
+}
@@ -0,0 +1,54 @@
+#ifndef PS2GV_EVENTS_H
+#define PS2GV_EVENTS_H
+#include "ps2gv/config-settings.h"
+#include "ps2gv/process-capture.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process table kept current by the Linux netlink proc connector
+// (fork/exec/exit events) instead of re-running ps every interval.
+//
+// The table is seeded once from /proc, then only processes that forked,
+// exec'd or are big enough to matter for the scale mode get their /proc
+// columns re-read, with a full /proc rescan every event_full_refresh samples
+// that also catches pids whose events got lost.
+// Processes that came and went inside a sampling window still show up in
+// that sample, which is what makes fork storms visible.
+//
+// Listening needs CAP_NET_ADMIN and a kernel that acknowledges it, which
+// containers often don't; without either (or off Linux) every sample is a
+// plain capture_live(). Either way the result is the same
+// ProcessInfo stream generate_graph() already knows.
+class ProcessMonitor {
+public:
+	explicit ProcessMonitor(const Config& config);
+	~ProcessMonitor();
+	ProcessMonitor(const ProcessMonitor&) = delete;
+	ProcessMonitor& operator=(const ProcessMonitor&) = delete;
+
+	bool event_driven() const { return socket_fd_ >= 0; }
+	// Collect events for `window`, then return the current process table.
+	// When polling, this is just capture_live() and does not wait.
+	std::vector<ProcessInfo> sample(std::chrono::milliseconds window);
+
+private:
+	struct Entry {
+		ProcessInfo info;
+		bool dirty = true; // needs command/unit/columns re-read
+		bool exited = false; // reported once more, then dropped
+	};
+
+	bool subscribe();
+	void rescan();
+	void drain(std::chrono::steady_clock::time_point deadline);
+	void refresh(bool full);
+
+	const Config& config_;
+	int socket_fd_ = -1;
+	unsigned samples_ = 0;
+	std::unordered_map<int32_t, Entry> table_;
+};
+#endif // PS2GV_EVENTS_H
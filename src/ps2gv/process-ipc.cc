@@ -0,0 +1,231 @@
+#include "ps2gv/process-ipc.h"
+#include "common/parallel-for.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+namespace {
+// pipefs and sockfs number their inodes independently, keep them apart
+constexpr uint64_t PIPE = 0;
+constexpr uint64_t SOCKET = 1;
+
+struct FdScan {
+	std::vector<uint64_t> keys; // inode * 2 + PIPE|SOCKET, sorted, once each
+	bool denied = false;
+	bool truncated = false;
+};
+
+// readlinkat() on the open fd dir, no path building per descriptor
+FdScan scan_fds(const std::string& pid, size_t max_fds)
+{
+	FdScan scan;
+	DIR* dir = opendir(("/proc/" + pid + "/fd").c_str());
+	if (!dir) {
+		scan.denied = errno == EACCES; // else gone since ps ran
+		return scan;
+	}
+	const int dir_fd = dirfd(dir);
+	size_t seen = 0;
+	char target[64];
+	while (const dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] == '.')
+			continue;
+		if (seen++ >= max_fds) {
+			scan.truncated = true;
+			break;
+		}
+		const ssize_t length = readlinkat(dir_fd, entry->d_name, target, sizeof(target) - 1);
+		if (length <= 0)
+			continue;
+		target[length] = '\0';
+		if (std::strncmp(target, "pipe:[", 6) == 0)
+			scan.keys.push_back(std::strtoull(target + 6, nullptr, 10) * 2 + PIPE);
+		else if (std::strncmp(target, "socket:[", 8) == 0)
+			scan.keys.push_back(std::strtoull(target + 8, nullptr, 10) * 2 + SOCKET);
+	}
+	closedir(dir);
+	// dup()ed and inherited descriptors, one link is enough
+	std::sort(scan.keys.begin(), scan.keys.end());
+	scan.keys.erase(std::unique(scan.keys.begin(), scan.keys.end()), scan.keys.end());
+	return scan;
+}
+
+// inode -> path ("" for unnamed and abstract-less sockets)
+std::unordered_map<uint64_t, std::string> read_unix_sockets()
+{
+	std::unordered_map<uint64_t, std::string> sockets;
+	std::ifstream file("/proc/net/unix");
+	std::string line;
+	std::getline(file, line); // Num RefCount Protocol Flags Type St Inode Path
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string skip;
+		uint64_t inode = 0;
+		fields >> skip >> skip >> skip >> skip >> skip >> skip >> inode;
+		if (!fields)
+			continue;
+		std::string path;
+		fields >> path;
+		sockets[inode] = path;
+	}
+	return sockets;
+}
+
+// inode -> inode of the other end, for every connected unix socket in our
+// network namespace. Empty if sock_diag is unavailable (no unix_diag module).
+std::unordered_map<uint64_t, uint64_t> read_unix_peers()
+{
+	std::unordered_map<uint64_t, uint64_t> peers;
+	const int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+	if (fd < 0)
+		return peers;
+	struct {
+		struct nlmsghdr header;
+		struct unix_diag_req request;
+	} message {};
+	message.header.nlmsg_len = sizeof(message);
+	message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+	message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	message.request.sdiag_family = AF_UNIX;
+	message.request.udiag_states = ~0u; // listening sockets have no peer, the rest may
+	message.request.udiag_show = UDIAG_SHOW_PEER;
+	struct sockaddr_nl kernel {};
+	kernel.nl_family = AF_NETLINK;
+	if (sendto(fd, &message, sizeof(message), 0, reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+		close(fd);
+		return peers;
+	}
+
+	alignas(struct nlmsghdr) char buffer[32 * 1024];
+	for (bool done = false; !done;) {
+		const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+		if (received < 0 && errno == EINTR)
+			continue;
+		if (received <= 0)
+			break;
+		int length = static_cast<int>(received);
+		for (auto* header = reinterpret_cast<struct nlmsghdr*>(buffer); NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+			if (header->nlmsg_type == NLMSG_DONE || header->nlmsg_type == NLMSG_ERROR) {
+				done = true;
+				break;
+			}
+			const auto* diag = static_cast<const struct unix_diag_msg*>(NLMSG_DATA(header));
+			int attributes = static_cast<int>(header->nlmsg_len) - static_cast<int>(NLMSG_LENGTH(sizeof(*diag)));
+			for (auto* attribute = reinterpret_cast<const struct rtattr*>(diag + 1); RTA_OK(attribute, attributes); attribute = RTA_NEXT(attribute, attributes)) {
+				if (attribute->rta_type != UNIX_DIAG_PEER || RTA_PAYLOAD(attribute) < sizeof(uint32_t))
+					continue;
+				uint32_t peer = 0;
+				std::memcpy(&peer, RTA_DATA(attribute), sizeof(peer));
+				if (peer != 0)
+					peers[diag->udiag_ino] = peer;
+			}
+		}
+	}
+	close(fd);
+	return peers;
+}
+} // namespace
+#endif
+
+std::vector<IpcLink> sample_ipc(const std::vector<ProcessInfo>& procs, const Config& config)
+{
+	std::vector<IpcLink> links;
+#ifdef __linux__
+	std::vector<size_t> selected;
+	for (size_t i = 0; i < procs.size(); ++i)
+		if (!procs[i].pid.empty() && std::isdigit(static_cast<unsigned char>(procs[i].pid[0])))
+			selected.push_back(i);
+
+	std::vector<FdScan> scans(selected.size());
+	parallel_for(selected.size(), config.detail_workers, [&](size_t s) {
+		scans[s] = scan_fds(procs[selected[s]].pid, config.ipc_max_fds);
+	});
+	const auto unix_sockets = read_unix_sockets();
+	const auto unix_peers = read_unix_peers();
+
+	// inode -> every process holding it, in process order
+	std::unordered_map<uint64_t, std::vector<size_t>> holders;
+	size_t unreadable = 0, truncated = 0;
+	for (size_t s = 0; s < scans.size(); ++s) {
+		unreadable += scans[s].denied;
+		truncated += scans[s].truncated;
+		for (uint64_t key : scans[s].keys)
+			holders[key].push_back(s);
+	}
+
+	// one link per process pair and kind, ordered so the graph comes out the same every run
+	std::map<std::tuple<size_t, size_t, std::string>, IpcLink> by_pair;
+	auto add_link = [&](size_t from, size_t to, const std::string& kind, const std::string& detail) {
+		IpcLink& link = by_pair[{ from, to, kind }];
+		link.from = procs[selected[from]].pid;
+		link.to = procs[selected[to]].pid;
+		link.kind = kind;
+		link.shared++;
+		if (link.detail.empty())
+			link.detail = detail;
+	};
+	for (const auto& [key, holding] : holders) {
+		if (holding.size() < 2)
+			continue;
+		std::string kind = "pipe", detail;
+		if (key % 2 == SOCKET) {
+			const auto socket = unix_sockets.find(key / 2);
+			kind = socket != unix_sockets.end() ? "unix" : "socket";
+			if (socket != unix_sockets.end())
+				detail = socket->second;
+		}
+		for (size_t h = 1; h < holding.size(); ++h)
+			add_link(holding[0], holding[h], kind, detail);
+	}
+	// The two ends of a connection are different inodes. Linking the first
+	// holders of each end is enough, the other holders hang off those above.
+	for (const auto& [inode, peer] : unix_peers) {
+		if (inode > peer && unix_peers.count(peer))
+			continue; // both ends reported, take the pair once
+		const auto ours = holders.find(inode * 2 + SOCKET);
+		const auto theirs = holders.find(peer * 2 + SOCKET);
+		if (ours == holders.end() || theirs == holders.end() || ours->second[0] == theirs->second[0])
+			continue;
+		// the listening side's end carries the path
+		std::string detail;
+		for (uint64_t end : { inode, peer }) {
+			const auto socket = unix_sockets.find(end);
+			if (detail.empty() && socket != unix_sockets.end())
+				detail = socket->second;
+		}
+		add_link(std::min(ours->second[0], theirs->second[0]), std::max(ours->second[0], theirs->second[0]), "unix", detail);
+	}
+	links.reserve(by_pair.size());
+	for (auto& entry : by_pair)
+		links.push_back(std::move(entry.second));
+
+	if (unreadable > 0)
+		std::cerr << "Warning: " << unreadable << " processes' fds were unreadable, their IPC needs root to show up.\n";
+	if (truncated > 0)
+		std::cerr << "Warning: " << truncated << " processes hold more than " << config.ipc_max_fds << " fds (ipc_max_fds), the rest were skipped.\n";
+#else
+	(void)procs;
+	(void)config;
+	std::cerr << "Warning: --ipc needs Linux /proc, no IPC edges will be shown.\n";
+#endif
+	return links;
+}
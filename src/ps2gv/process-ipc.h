@@ -0,0 +1,25 @@
+#ifndef PS2GV_IPC_H
+#define PS2GV_IPC_H
+#include "ps2gv/config-settings.h"
+#include "ps2gv/process-capture.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Two processes holding the same pipe or socket
+struct IpcLink {
+	std::string from; // pid of the lower index holder, usually the parent
+	std::string to;
+	std::string kind; // "pipe", "unix" or "socket"
+	size_t shared = 0; // inodes of that kind they share
+	std::string detail; // a unix socket path, if any
+};
+
+// Reads every /proc/<pid>/fd over detail_workers threads, at most ipc_max_fds
+// links per process, and /proc/net/unix to tell unix sockets from the rest.
+// Inodes held by several processes link each holder to the first one, so a
+// pipe shared by a thousand workers is a thousand edges, not a million.
+// Connected unix sockets have one inode per end, sock_diag pairs them up
+// (in our network namespace only). Linux only, empty elsewhere.
+std::vector<IpcLink> sample_ipc(const std::vector<ProcessInfo>& procs, const Config& config);
+#endif // PS2GV_IPC_H
@@ -0,0 +1,165 @@
+#include "ps2gv/process-threads.h"
+#include "common/parallel-for.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+namespace {
+struct TaskSample {
+	size_t proc; // index into the selected pids
+	long tid;
+	std::string comm;
+	uint64_t ticks = 0; // utime + stime
+	bool ok = false;
+};
+
+std::vector<long> list_tasks(const std::string& pid)
+{
+	std::vector<long> tids;
+	DIR* dir = opendir(("/proc/" + pid + "/task").c_str());
+	if (!dir)
+		return tids; // gone already
+	while (const dirent* entry = readdir(dir))
+		if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9')
+			tids.push_back(std::strtol(entry->d_name, nullptr, 10));
+	closedir(dir);
+	return tids;
+}
+
+// One open+read+close on a stack buffer, this runs 100k times a pass
+bool read_task(const std::string& pid, TaskSample& task)
+{
+	const std::string path = "/proc/" + pid + "/task/" + std::to_string(task.tid) + "/stat";
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	char buffer[1024];
+	const ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (length <= 0)
+		return false;
+	buffer[length] = '\0';
+
+	// comm can hold spaces and parens, the other fields resume after the last ')'
+	char* open_paren = std::strchr(buffer, '(');
+	char* close_paren = std::strrchr(buffer, ')');
+	if (!open_paren || !close_paren || close_paren < open_paren)
+		return false;
+	task.comm.assign(open_paren + 1, close_paren);
+
+	// state is field 3, utime and stime are 14 and 15
+	const char* field = close_paren + 1;
+	for (int i = 3; i < 14 && field; ++i)
+		field = std::strchr(field + 1, ' ');
+	if (!field)
+		return false;
+	char* end = nullptr;
+	const uint64_t utime = std::strtoull(field, &end, 10);
+	const uint64_t stime = std::strtoull(end, &end, 10);
+	task.ticks = utime + stime;
+	return true;
+}
+
+// List every selected process' tasks, then read them all. Listing first keeps
+// the reads balanced when one process owns most of the threads.
+std::vector<TaskSample> read_tasks(const std::vector<std::string>& pids, unsigned workers)
+{
+	std::vector<std::vector<long>> tids(pids.size());
+	parallel_for(pids.size(), workers, [&](size_t p) {
+		tids[p] = list_tasks(pids[p]);
+	});
+
+	std::vector<TaskSample> tasks;
+	for (size_t p = 0; p < pids.size(); ++p)
+		for (long tid : tids[p])
+			tasks.push_back({ p, tid, {}, 0, false });
+	parallel_for(tasks.size(), workers, [&](size_t t) {
+		tasks[t].ok = read_task(pids[tasks[t].proc], tasks[t]);
+	});
+	return tasks;
+}
+
+float to_float(const std::string& s)
+{
+	try {
+		return std::stof(s);
+	} catch (...) {
+		return 0.0f;
+	}
+}
+} // namespace
+#endif
+
+std::vector<ThreadGroup> sample_threads(const std::vector<ProcessInfo>& procs, const std::vector<std::string>& pids, const Config& config)
+{
+	std::vector<ThreadGroup> groups;
+#ifdef __linux__
+	// which processes get expanded
+	std::vector<std::string> selected;
+	if (!pids.empty()) {
+		const std::unordered_set<std::string> wanted(pids.begin(), pids.end());
+		for (const auto& proc : procs)
+			if (wanted.count(proc.pid))
+				selected.push_back(proc.pid);
+	} else {
+		for (const auto& proc : procs)
+			if (to_float(proc.pcpu) >= config.thread_min_cpu)
+				selected.push_back(proc.pid);
+	}
+	if (selected.empty())
+		return groups;
+
+	const auto started = std::chrono::steady_clock::now();
+	const auto first = read_tasks(selected, config.detail_workers);
+	std::unordered_map<long, uint64_t> first_ticks;
+	first_ticks.reserve(first.size());
+	for (const auto& task : first)
+		if (task.ok)
+			first_ticks.emplace(task.tid, task.ticks);
+
+	std::this_thread::sleep_until(started + std::chrono::milliseconds(config.thread_sample_interval_ms));
+	const auto second = read_tasks(selected, config.detail_workers);
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	const double ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+
+	// group by process and name, ordered so the graph comes out the same every run
+	std::map<std::pair<size_t, std::string>, ThreadGroup> by_name;
+	for (const auto& task : second) {
+		if (!task.ok)
+			continue;
+		// threads started mid-interval spent all of their time in it
+		const auto before = first_ticks.find(task.tid);
+		const uint64_t base = before != first_ticks.end() ? before->second : 0;
+		const uint64_t delta = task.ticks > base ? task.ticks - base : 0;
+
+		ThreadGroup& group = by_name[{ task.proc, task.comm }];
+		group.pid = selected[task.proc];
+		group.comm = task.comm;
+		group.count++;
+		group.pcpu += static_cast<float>(delta / ticks_per_second / elapsed * 100.0);
+		group.tids.push_back(task.tid);
+	}
+	groups.reserve(by_name.size());
+	for (auto& entry : by_name)
+		groups.push_back(std::move(entry.second));
+#else
+	(void)procs;
+	(void)pids;
+	(void)config;
+	std::cerr << "Warning: --threads needs Linux /proc, no threads will be shown.\n";
+#endif
+	return groups;
+}
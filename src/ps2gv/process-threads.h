@@ -0,0 +1,24 @@
+#ifndef PS2GV_THREADS_H
+#define PS2GV_THREADS_H
+#include "ps2gv/config-settings.h"
+#include "ps2gv/process-capture.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Threads of one process sharing a name (comm), e.g. 64 "worker" threads
+struct ThreadGroup {
+	std::string pid; // owning process
+	std::string comm;
+	size_t count = 0;
+	float pcpu = 0.0f; // summed over the group, over the sampling interval
+	std::vector<long> tids;
+};
+
+// Threads of the processes in `pids`, or when that's empty of every process
+// at or above thread_min_cpu. /proc/<pid>/task/*/stat is read twice,
+// thread_sample_interval_ms apart, for the CPU each thread used in between.
+// Both passes list the task dirs and then read every stat file over
+// detail_workers threads. Linux only, empty elsewhere.
+std::vector<ThreadGroup> sample_threads(const std::vector<ProcessInfo>& procs, const std::vector<std::string>& pids, const Config& config);
+#endif // PS2GV_THREADS_H
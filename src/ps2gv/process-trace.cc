@@ -0,0 +1,473 @@
+#include "ps2gv/process-trace.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+constexpr char FILE_MAGIC[8] = { 'P', 'S', 'T', 'R', 'A', 'C', 'E', '1' };
+constexpr char INDEX_MAGIC[8] = { 'P', 'S', 'T', 'R', 'I', 'D', 'X', '1' };
+constexpr uint32_t FRAME_MAGIC = 0x52465350; // "PSFR"
+constexpr uint64_t FILE_HEADER_SIZE = 8;
+constexpr uint64_t FRAME_HEADER_SIZE = 24; // magic, payload length, timestamp, process count, dictionary size
+constexpr uint64_t INDEX_HEADER_SIZE = 8;
+constexpr uint64_t INDEX_RECORD_SIZE = 24; // timestamp, offset, length
+constexpr uint64_t PROCESS_COLUMNS = 7; // varints per process: pid, ppid, rss, pcpu, zone, command, unit
+
+// closes on scope exit, so exceptions don't leak descriptors
+struct FileDescriptor {
+	int fd = -1;
+	explicit FileDescriptor(int f)
+	    : fd(f)
+	{
+	}
+	~FileDescriptor()
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+	FileDescriptor(const FileDescriptor&) = delete;
+	FileDescriptor& operator=(const FileDescriptor&) = delete;
+};
+
+struct IndexRecord {
+	int64_t timestamp;
+	uint64_t offset;
+	uint64_t length;
+};
+
+// everything on disk is little endian
+void put_u32(std::string& out, uint32_t v)
+{
+	for (int i = 0; i < 4; ++i)
+		out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+void put_u64(std::string& out, uint64_t v)
+{
+	for (int i = 0; i < 8; ++i)
+		out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+uint32_t get_u32(const unsigned char* p)
+{
+	uint32_t v = 0;
+	for (int i = 0; i < 4; ++i)
+		v |= static_cast<uint32_t>(p[i]) << (8 * i);
+	return v;
+}
+
+uint64_t get_u64(const unsigned char* p)
+{
+	uint64_t v = 0;
+	for (int i = 0; i < 8; ++i)
+		v |= static_cast<uint64_t>(p[i]) << (8 * i);
+	return v;
+}
+
+void put_varint(std::string& out, uint64_t v)
+{
+	while (v >= 0x80) {
+		out.push_back(static_cast<char>(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back(static_cast<char>(v));
+}
+
+uint64_t zigzag(int64_t v)
+{
+	return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v)
+{
+	return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+struct FrameReader {
+	const unsigned char* cur;
+	const unsigned char* end;
+
+	uint64_t varint()
+	{
+		uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (cur == end)
+				break;
+			const unsigned char byte = *cur++;
+			v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				return v;
+		}
+		throw std::runtime_error("Corrupt pstrace frame: bad varint");
+	}
+
+	std::string bytes(uint64_t n)
+	{
+		if (static_cast<uint64_t>(end - cur) < n)
+			throw std::runtime_error("Corrupt pstrace frame: truncated string");
+		std::string s(reinterpret_cast<const char*>(cur), n);
+		cur += n;
+		return s;
+	}
+};
+
+bool parse_u64(const std::string& s, uint64_t& out)
+{
+	if (s.empty() || !std::isdigit(static_cast<unsigned char>(s[0])))
+		return false;
+	char* end = nullptr;
+	out = std::strtoull(s.c_str(), &end, 10);
+	return *end == '\0';
+}
+
+void write_all(int fd, const std::string& data, uint64_t offset, const std::string& what)
+{
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = pwrite(fd, data.data() + done, data.size() - done, static_cast<off_t>(offset + done));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("Cannot write " + what + ": " + std::strerror(errno));
+		}
+		done += static_cast<size_t>(n);
+	}
+}
+
+bool read_exact(int fd, unsigned char* buf, size_t len, uint64_t offset)
+{
+	size_t done = 0;
+	while (done < len) {
+		ssize_t n = pread(fd, buf + done, len - done, static_cast<off_t>(offset + done));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += static_cast<size_t>(n);
+	}
+	return true;
+}
+
+std::string encode_frame(const std::vector<ProcessInfo>& procs, int64_t timestamp)
+{
+	struct Row {
+		uint64_t pid, ppid, rss, pcpu;
+		uint32_t zone, command, unit;
+	};
+
+	std::unordered_map<std::string, uint32_t> dictionary;
+	std::vector<const std::string*> strings;
+	auto intern = [&](const std::string& s) {
+		auto [it, inserted] = dictionary.emplace(s, static_cast<uint32_t>(strings.size()));
+		if (inserted)
+			strings.push_back(&it->first);
+		return it->second;
+	};
+
+	std::vector<Row> rows;
+	rows.reserve(procs.size());
+	for (const auto& proc : procs) {
+		Row row {};
+		if (!parse_u64(proc.pid, row.pid))
+			continue; // same rule as generate_graph(), no pid no node
+		parse_u64(proc.ppid, row.ppid);
+		parse_u64(proc.rss, row.rss);
+		const float pcpu = std::strtof(proc.pcpu.c_str(), nullptr);
+		row.pcpu = pcpu > 0.0f ? static_cast<uint64_t>(std::lround(pcpu * 10.0f)) : 0;
+		row.zone = intern(proc.zone);
+		row.command = intern(proc.command);
+		row.unit = intern(proc.unit);
+		rows.push_back(row);
+	}
+	// sorted pids turn into small positive deltas
+	std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.pid < b.pid; });
+
+	std::string payload;
+	payload.reserve(rows.size() * 12);
+	for (const auto* s : strings) {
+		put_varint(payload, s->size());
+		payload += *s;
+	}
+	uint64_t prev_pid = 0;
+	for (const auto& row : rows) {
+		put_varint(payload, row.pid - prev_pid);
+		prev_pid = row.pid;
+	}
+	int64_t prev_ppid = 0;
+	for (const auto& row : rows) {
+		put_varint(payload, zigzag(static_cast<int64_t>(row.ppid) - prev_ppid));
+		prev_ppid = static_cast<int64_t>(row.ppid);
+	}
+	for (const auto& row : rows)
+		put_varint(payload, row.rss);
+	for (const auto& row : rows)
+		put_varint(payload, row.pcpu);
+	for (const auto& row : rows)
+		put_varint(payload, row.zone);
+	for (const auto& row : rows)
+		put_varint(payload, row.command);
+	for (const auto& row : rows)
+		put_varint(payload, row.unit);
+
+	std::string frame;
+	frame.reserve(FRAME_HEADER_SIZE + payload.size());
+	put_u32(frame, FRAME_MAGIC);
+	put_u32(frame, static_cast<uint32_t>(payload.size()));
+	put_u64(frame, static_cast<uint64_t>(timestamp));
+	put_u32(frame, static_cast<uint32_t>(rows.size()));
+	put_u32(frame, static_cast<uint32_t>(strings.size()));
+	frame += payload;
+	return frame;
+}
+
+TraceFrame decode_frame(const unsigned char* data, uint64_t length)
+{
+	if (length < FRAME_HEADER_SIZE || get_u32(data) != FRAME_MAGIC || get_u32(data + 4) != length - FRAME_HEADER_SIZE)
+		throw std::runtime_error("Corrupt pstrace frame header");
+
+	TraceFrame frame;
+	frame.timestamp = static_cast<int64_t>(get_u64(data + 8));
+	const uint32_t count = get_u32(data + 16);
+	const uint32_t dict_size = get_u32(data + 20);
+	FrameReader reader { data + FRAME_HEADER_SIZE, data + length };
+	// every string takes at least its length byte and every process a byte per
+	// column, so a corrupt count fails here instead of allocating gigabytes
+	const uint64_t payload = length - FRAME_HEADER_SIZE;
+	if (dict_size > payload || count > (payload - dict_size) / PROCESS_COLUMNS)
+		throw std::runtime_error("Corrupt pstrace frame: counts exceed the payload");
+
+	std::vector<std::string> strings(dict_size);
+	for (auto& s : strings)
+		s = reader.bytes(reader.varint());
+	auto lookup = [&](uint64_t id) -> const std::string& {
+		if (id >= strings.size())
+			throw std::runtime_error("Corrupt pstrace frame: bad dictionary index");
+		return strings[id];
+	};
+
+	frame.procs.resize(count);
+	uint64_t pid = 0;
+	for (auto& proc : frame.procs) {
+		pid += reader.varint();
+		proc.pid = std::to_string(pid);
+	}
+	int64_t ppid = 0;
+	for (auto& proc : frame.procs) {
+		ppid += unzigzag(reader.varint());
+		proc.ppid = std::to_string(ppid);
+	}
+	for (auto& proc : frame.procs)
+		proc.rss = std::to_string(reader.varint());
+	for (auto& proc : frame.procs) {
+		const uint64_t tenths = reader.varint();
+		proc.pcpu = std::to_string(tenths / 10) + "." + std::to_string(tenths % 10);
+	}
+	for (auto& proc : frame.procs)
+		proc.zone = lookup(reader.varint());
+	for (auto& proc : frame.procs)
+		proc.command = lookup(reader.varint());
+	for (auto& proc : frame.procs)
+		proc.unit = lookup(reader.varint());
+	return frame;
+}
+
+std::string index_path(const std::string& trace_file)
+{
+	return trace_file + ".idx";
+}
+
+// Make sure "<file>.idx" covers every complete frame in the data file,
+// rebuilding it from the frame headers when it is missing or stale.
+// Returns where the last complete frame ends.
+uint64_t ensure_index(const std::string& trace_file, int data_fd, uint64_t data_size)
+{
+	const std::string idx_file = index_path(trace_file);
+	{
+		FileDescriptor idx(open(idx_file.c_str(), O_RDONLY));
+		struct stat st;
+		if (idx.fd >= 0 && fstat(idx.fd, &st) == 0 && static_cast<uint64_t>(st.st_size) >= INDEX_HEADER_SIZE
+		    && (static_cast<uint64_t>(st.st_size) - INDEX_HEADER_SIZE) % INDEX_RECORD_SIZE == 0) {
+			unsigned char magic[INDEX_HEADER_SIZE];
+			unsigned char last[INDEX_RECORD_SIZE];
+			if (read_exact(idx.fd, magic, sizeof(magic), 0) && std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) == 0) {
+				if (static_cast<uint64_t>(st.st_size) == INDEX_HEADER_SIZE) {
+					if (data_size == FILE_HEADER_SIZE)
+						return FILE_HEADER_SIZE;
+				} else if (read_exact(idx.fd, last, sizeof(last), st.st_size - INDEX_RECORD_SIZE)) {
+					const uint64_t end = get_u64(last + 8) + get_u64(last + 16);
+					if (end == data_size)
+						return end;
+				}
+			}
+		}
+	}
+
+	// walk the frame headers, skipping payloads
+	std::string records(INDEX_MAGIC, INDEX_HEADER_SIZE);
+	uint64_t offset = FILE_HEADER_SIZE;
+	unsigned char header[FRAME_HEADER_SIZE];
+	while (offset + FRAME_HEADER_SIZE <= data_size && read_exact(data_fd, header, sizeof(header), offset)) {
+		if (get_u32(header) != FRAME_MAGIC)
+			break;
+		const uint64_t length = FRAME_HEADER_SIZE + get_u32(header + 4);
+		if (offset + length > data_size)
+			break; // torn write at the tail
+		put_u64(records, get_u64(header + 8));
+		put_u64(records, offset);
+		put_u64(records, length);
+		offset += length;
+	}
+
+	// publish atomically, readers may be racing us
+	const std::string tmp_file = idx_file + ".tmp." + std::to_string(getpid());
+	{
+		FileDescriptor tmp(open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+		if (tmp.fd < 0)
+			throw std::runtime_error("Cannot create pstrace index: " + tmp_file);
+		write_all(tmp.fd, records, 0, tmp_file);
+	}
+	if (rename(tmp_file.c_str(), idx_file.c_str()) != 0) {
+		unlink(tmp_file.c_str());
+		throw std::runtime_error("Cannot update pstrace index: " + idx_file);
+	}
+	return offset;
+}
+
+void check_file_header(int fd, const std::string& trace_file)
+{
+	unsigned char magic[FILE_HEADER_SIZE];
+	if (!read_exact(fd, magic, sizeof(magic), 0) || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0)
+		throw std::runtime_error("Not a pstrace file: " + trace_file);
+}
+} // namespace
+
+void record_snapshot(const std::string& trace_file, const std::vector<ProcessInfo>& procs, int64_t timestamp)
+{
+	FileDescriptor data(open(trace_file.c_str(), O_RDWR | O_CREAT, 0644));
+	if (data.fd < 0)
+		throw std::runtime_error("Cannot open pstrace file: " + trace_file);
+	// one writer at a time, replays hold a shared lock
+	if (flock(data.fd, LOCK_EX) != 0)
+		throw std::runtime_error("Cannot lock pstrace file: " + trace_file);
+
+	struct stat st;
+	if (fstat(data.fd, &st) != 0)
+		throw std::runtime_error("Cannot stat pstrace file: " + trace_file);
+	uint64_t data_size = static_cast<uint64_t>(st.st_size);
+	if (data_size == 0) {
+		write_all(data.fd, std::string(FILE_MAGIC, FILE_HEADER_SIZE), 0, trace_file);
+		data_size = FILE_HEADER_SIZE;
+	}
+	check_file_header(data.fd, trace_file);
+
+	// drop a torn frame left behind by an interrupted recording
+	const uint64_t offset = ensure_index(trace_file, data.fd, data_size);
+	if (offset != data_size && ftruncate(data.fd, static_cast<off_t>(offset)) != 0)
+		throw std::runtime_error("Cannot truncate pstrace file: " + trace_file);
+
+	// replay binary-searches on time, so keep timestamps monotonic
+	const std::string idx_file = index_path(trace_file);
+	FileDescriptor idx(open(idx_file.c_str(), O_RDWR));
+	if (idx.fd < 0 || fstat(idx.fd, &st) != 0)
+		throw std::runtime_error("Cannot open pstrace index: " + idx_file);
+	const uint64_t idx_size = static_cast<uint64_t>(st.st_size);
+	unsigned char last[INDEX_RECORD_SIZE];
+	if (idx_size > INDEX_HEADER_SIZE && read_exact(idx.fd, last, sizeof(last), idx_size - INDEX_RECORD_SIZE))
+		timestamp = std::max(timestamp, static_cast<int64_t>(get_u64(last)));
+
+	const std::string frame = encode_frame(procs, timestamp);
+	write_all(data.fd, frame, offset, trace_file);
+
+	std::string record;
+	put_u64(record, static_cast<uint64_t>(timestamp));
+	put_u64(record, offset);
+	put_u64(record, frame.size());
+	write_all(idx.fd, record, idx_size, idx_file);
+}
+
+TraceFrame replay_snapshot(const std::string& trace_file, int64_t at)
+{
+	FileDescriptor data(open(trace_file.c_str(), O_RDONLY));
+	if (data.fd < 0)
+		throw std::runtime_error("Cannot open pstrace file: " + trace_file);
+	if (flock(data.fd, LOCK_SH) != 0)
+		throw std::runtime_error("Cannot lock pstrace file: " + trace_file);
+	struct stat st;
+	if (fstat(data.fd, &st) != 0)
+		throw std::runtime_error("Cannot stat pstrace file: " + trace_file);
+	check_file_header(data.fd, trace_file);
+	ensure_index(trace_file, data.fd, static_cast<uint64_t>(st.st_size));
+
+	// map the index and binary search on time
+	const std::string idx_file = index_path(trace_file);
+	FileDescriptor idx(open(idx_file.c_str(), O_RDONLY));
+	struct stat idx_st;
+	if (idx.fd < 0 || fstat(idx.fd, &idx_st) != 0)
+		throw std::runtime_error("Cannot open pstrace index: " + idx_file);
+	const uint64_t records = (static_cast<uint64_t>(idx_st.st_size) - INDEX_HEADER_SIZE) / INDEX_RECORD_SIZE;
+	if (records == 0)
+		throw std::runtime_error("No frames recorded in " + trace_file);
+	void* idx_map = mmap(nullptr, idx_st.st_size, PROT_READ, MAP_PRIVATE, idx.fd, 0);
+	if (idx_map == MAP_FAILED)
+		throw std::runtime_error("Cannot map pstrace index: " + idx_file);
+	const auto* base = static_cast<const unsigned char*>(idx_map) + INDEX_HEADER_SIZE;
+	auto record_at = [&](uint64_t i) {
+		const unsigned char* p = base + i * INDEX_RECORD_SIZE;
+		return IndexRecord { static_cast<int64_t>(get_u64(p)), get_u64(p + 8), get_u64(p + 16) };
+	};
+	uint64_t lo = 0, hi = records; // first record newer than `at`
+	while (lo < hi) {
+		const uint64_t mid = lo + (hi - lo) / 2;
+		if (record_at(mid).timestamp <= at)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	const IndexRecord record = record_at(lo == 0 ? 0 : lo - 1);
+	munmap(idx_map, idx_st.st_size);
+	if (lo == 0)
+		throw std::runtime_error("No frame recorded at or before " + std::to_string(at) + " in " + trace_file);
+
+	// map just the pages holding this frame
+	const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	const uint64_t aligned = record.offset & ~(page - 1);
+	const size_t map_length = static_cast<size_t>(record.length + (record.offset - aligned));
+	void* frame_map = mmap(nullptr, map_length, PROT_READ, MAP_PRIVATE, data.fd, static_cast<off_t>(aligned));
+	if (frame_map == MAP_FAILED)
+		throw std::runtime_error("Cannot map pstrace frame in " + trace_file);
+	try {
+		TraceFrame frame = decode_frame(static_cast<const unsigned char*>(frame_map) + (record.offset - aligned), record.length);
+		munmap(frame_map, map_length);
+		return frame;
+	} catch (...) {
+		munmap(frame_map, map_length);
+		throw;
+	}
+}
+
+int64_t parse_trace_time(const std::string& text)
+{
+	if (!text.empty() && std::all_of(text.begin(), text.end(), [](unsigned char c) { return std::isdigit(c); }))
+		return std::stoll(text);
+
+	std::string normalised = text;
+	std::replace(normalised.begin(), normalised.end(), 'T', ' ');
+	struct tm tm {};
+	const char* end = strptime(normalised.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+	if (!end || *end != '\0')
+		throw std::invalid_argument("Invalid time '" + text + "', use epoch seconds or YYYY-MM-DD HH:MM:SS");
+	tm.tm_isdst = -1;
+	return static_cast<int64_t>(mktime(&tm));
+}
@@ -0,0 +1,31 @@
+#ifndef PS2GV_TRACE_H
+#define PS2GV_TRACE_H
+#include "ps2gv/process-capture.h"
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Binary recording of ps snapshots (.pstrace)
+//
+// The data file is a header followed by self-contained frames, one per
+// snapshot. Each frame stores its process table column by column: rows are
+// sorted by pid, pid/ppid are varint deltas against the previous row, rss and
+// pcpu (in tenths) are plain varints, and zone/command/unit are indices into a
+// per-frame string dictionary. A sidecar "<file>.idx" holds fixed size
+// (timestamp, offset, length) records so any frame is found without touching
+// the data file, and only that frame gets memory-mapped on replay.
+
+struct TraceFrame {
+	int64_t timestamp = 0; // seconds since epoch
+	std::vector<ProcessInfo> procs;
+};
+
+constexpr int64_t TRACE_LATEST = std::numeric_limits<int64_t>::max();
+
+void record_snapshot(const std::string& trace_file, const std::vector<ProcessInfo>& procs, int64_t timestamp);
+// Last frame recorded at or before `at`
+TraceFrame replay_snapshot(const std::string& trace_file, int64_t at = TRACE_LATEST);
+// Epoch seconds or local "YYYY-MM-DD HH:MM:SS" (a 'T' separator works too)
+int64_t parse_trace_time(const std::string& text);
+#endif // PS2GV_TRACE_H
@@ -1,40 +1,178 @@
 // TODO: Take multiple snapshots to construct an animated version
+#include "common/output.h"
 #include "ps2gv/cli-parser.h"
 #include "ps2gv/config-settings.h"
+#include "ps2gv/fleet-merge.h"
 #include "ps2gv/graph-generator.h"
 #include "ps2gv/process-capture.h"
+#include "ps2gv/process-detail.h"
+#include "ps2gv/process-events.h"
+#include "ps2gv/process-ipc.h"
+#include "ps2gv/process-threads.h"
+#include "ps2gv/process-trace.h"
+#include "ps2gv/serve.h"
+#include "ps2gv/snapshot-diff.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <sys/stat.h>
+#include <utility>
+
+// -o if given, else <stem>.<format> in the current directory
+static std::string output_path(const Options& options, const std::string& stem)
+{
+	if (!options.output_file.empty())
+		return options.output_file;
+	return stem + "." + output_format("", options.format);
+}
+
+// --at if given, else when the snapshot file was last written, else now
+static int64_t snapshot_time(const Options& options, const std::string& input_file)
+{
+	if (!options.at_time.empty())
+		return parse_trace_time(options.at_time);
+	struct stat st;
+	if (input_file != STDIO_PATH && stat(input_file.c_str(), &st) == 0)
+		return static_cast<int64_t>(st.st_mtime);
+	return static_cast<int64_t>(std::time(nullptr));
+}
+
+// ps2gv's own name for a graph read from stdin
+static std::string input_stem(const std::string& input_file)
+{
+	return input_file == STDIO_PATH ? "ptree" : std::filesystem::path(input_file).stem().string();
+}
+
+static RenderOptions render_options(const Options& options, const std::string& format, const RenderCache* cache)
+{
+	RenderOptions render;
+	render.format = format;
+	render.layout.engine = options.engine;
+	render.layout.timeout_ms = options.layout_timeout_ms;
+	render.cache = cache;
+	return render;
+}
+
+// step 2 & 3: generate the graph and output results, one file or tiled.
+// False if some tile failed, the error is already printed
+static bool output_graph(const std::vector<ProcessInfo>& ps_info, const Config& config, const Options& options, const std::string& output_file, const RenderCache* cache, const std::vector<ThreadGroup>& threads = {}, const std::vector<IpcLink>& ipc = {})
+{
+	const std::string format = output_format(output_file, options.format);
+	if (options.tile_budget > 0) {
+		TileOptions tiles;
+		tiles.node_budget = options.tile_budget;
+		// tiles are bounded, size the engine for a full one
+		tiles.engine = options.engine == "auto" ? auto_engine(options.tile_budget, options.tile_budget) : options.engine;
+		tiles.format = format;
+		tiles.timeout_ms = options.layout_timeout_ms;
+		tiles.graph_header = "node [style=filled];";
+		tiles.output_prefix = std::filesystem::path(output_file).replace_extension().string();
+		return render_tiled(build_process_tree(ps_info, config, threads), tiles);
+	}
+	auto dot_graph = generate_graph(ps_info, config, threads, ipc);
+	render_graph(dot_graph, output_file, render_options(options, format, cache));
+	return true;
+}
 
 int main(int argc, char* argv[])
 {
+	// stdin/stdout are only used through iostreams, skip the stdio syncing
+	std::ios::sync_with_stdio(false);
+	bool rendered = true;
 	try {
 		auto options = parse_args(argc, argv);
 		Config config;
 		if (!options.config_file.empty())
 			config.load(options.config_file);
+		std::unique_ptr<RenderCache> cache;
+		if (!options.cache_dir.empty())
+			cache = std::make_unique<RenderCache>(options.cache_dir, options.cache_max_mb << 20);
 
-		if (options.use_ps_command) { // handle ps command case
+		if (!options.serve_address.empty()) { // keep everything warm, answer from memory
+			serve(options.serve_address, config, options.use_events, render_options(options, "svg", nullptr).layout);
+		} else if (!options.record_file.empty()) { // append snapshots to a binary trace
+			if (options.use_ps_command) {
+				auto ps_info = capture_live();
+				record_snapshot(options.record_file, ps_info, snapshot_time(options, STDIO_PATH));
+				std::cout << "Recorded " << ps_info.size() << " processes to " << options.record_file << std::endl;
+			} else {
+				// an archive of snapshots keeps its own times, oldest first as the trace needs them
+				std::vector<std::pair<int64_t, std::string>> inputs;
+				for (const auto& input_file : options.input_files)
+					inputs.emplace_back(snapshot_time(options, input_file), input_file);
+				std::stable_sort(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+				for (const auto& [timestamp, input_file] : inputs) {
+					auto ps_info = parse_ps_snapshot(input_file);
+					record_snapshot(options.record_file, ps_info, timestamp);
+					std::cout << "Recorded " << ps_info.size() << " processes from " << input_file << " to " << options.record_file << std::endl;
+				}
+			}
+		} else if (!options.replay_file.empty()) { // render a frame from a binary trace
 			// step 1: get process info
-			auto ps_info = capture_live();
+			auto at = options.at_time.empty() ? TRACE_LATEST : parse_trace_time(options.at_time);
+			auto frame = replay_snapshot(options.replay_file, at);
+
+			// step 2 & 3: generate DOT graph and output results
+			auto stem = input_stem(options.replay_file) + "-" + std::to_string(frame.timestamp);
+			rendered = output_graph(frame.procs, config, options, output_path(options, stem), cache.get());
+		} else if (options.diff_mode) { // handle before/after snapshot comparison
+			// step 1: get process info of both snapshots
+			auto before = parse_ps_snapshot(options.input_files[0]);
+			auto after = parse_ps_snapshot(options.input_files[1]);
+
+			// step 2: keep what changed and generate DOT graph
+			auto changes = diff_snapshots(before, after, config);
+			auto dot_graph = generate_diff_graph(changes, config);
 
-			// step 2: generate DOT graph
-			auto dot_graph = generate_graph(ps_info, config);
+			// step 3: output results
+			auto output_file = output_path(options, input_stem(options.input_files[1]) + "-diff");
+			render_graph(dot_graph, output_file, render_options(options, output_format(output_file, options.format), cache.get()));
+		} else if (options.merge_mode) { // one graph for a fleet of hosts
+			// step 1: get process info of every host
+			auto hosts = load_fleet(options.input_files, config.detail_workers);
+
+			// step 2: fold subtrees repeated across hosts and generate DOT graph
+			auto plan = plan_fleet(hosts, options.fold_min_hosts);
+			auto dot_graph = generate_fleet_graph(hosts, plan, config);
+			if (!plan.folds.empty())
+				std::cerr << "Folded " << plan.folds.size() << " subtrees shared by at least " << options.fold_min_hosts << " hosts\n";
 
 			// step 3: output results
-			render_graph(dot_graph, options.output_file);
+			auto output_file = output_path(options, "fleet");
+			render_graph(dot_graph, output_file, render_options(options, output_format(output_file, options.format), cache.get()));
+		} else if (options.use_ps_command) { // handle ps command case
+			// step 1: get process info
+			std::vector<ProcessInfo> ps_info;
+			if (options.use_events) {
+				ProcessMonitor monitor(config);
+				if (!monitor.event_driven())
+					std::cerr << "Warning: Proc connector unavailable, falling back to polling ps.\n";
+				ps_info = monitor.sample(std::chrono::milliseconds(config.event_window_ms));
+			} else {
+				ps_info = capture_live();
+			}
+			sample_process_detail(ps_info, config);
+			std::vector<ThreadGroup> threads;
+			if (options.show_threads)
+				threads = sample_threads(ps_info, options.thread_pids, config);
+			std::vector<IpcLink> ipc;
+			if (options.show_ipc)
+				ipc = sample_ipc(ps_info, config);
+
+			// step 2 & 3: generate DOT graph and output results
+			rendered = output_graph(ps_info, config, options, output_path(options, "ptree"), cache.get(), threads, ipc);
 		} else { // handle input files case
+			if (needs_process_detail(config.scale_mode))
+				std::cerr << "Warning: io/pss/uss scale modes need a live capture, nodes will not be scaled.\n";
 			for (const auto& input_file : options.input_files) {
 				// step 1: get process info
 				auto ps_info = parse_ps_snapshot(input_file);
 
-				// step 2: generate DOT graph
-				auto dot_graph = generate_graph(ps_info, config);
-
-				// step 3: output results
-				std::filesystem::path input_path(input_file);
-				auto output_file = input_path.stem().string() + ".svg";
-				render_graph(dot_graph, output_file);
+				// step 2 & 3: generate DOT graph and output results
+				rendered &= output_graph(ps_info, config, options, output_path(options, input_stem(input_file)), cache.get());
 			}
 		}
 
@@ -42,5 +180,5 @@ int main(int argc, char* argv[])
 		std::cerr << "Error: " << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
-	return EXIT_SUCCESS;
+	return rendered ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,311 @@
+#include "ps2gv/serve.h"
+#include "ps2gv/graph-generator.h"
+#include "ps2gv/process-capture.h"
+#include "ps2gv/process-detail.h"
+#include "ps2gv/process-events.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr int CONNECTION_WORKERS = 4;
+constexpr int CLIENT_TIMEOUT_S = 2; // slow clients don't get to hold a worker
+constexpr size_t MAX_REQUEST_SIZE = 8 * 1024;
+
+std::atomic<bool> stop_requested { false };
+
+void on_signal(int)
+{
+	stop_requested = true;
+}
+
+// Immutable once published, clients keep their copy alive while sending
+struct RenderCache {
+	std::string svg;
+	std::string dot;
+	std::string json;
+	int64_t captured_at = 0;
+};
+
+struct SharedState {
+	std::mutex mutex;
+	std::condition_variable wake; // sampler interval and shutdown
+	std::condition_variable pending_ready;
+	std::shared_ptr<const RenderCache> latest;
+	std::deque<int> pending; // accepted client sockets
+};
+
+// capture_live() forks ps from the sampler thread at any time, so the
+// close-on-exec flag has to be there from the start, not set afterwards
+int cloexec_socket(int domain)
+{
+#ifdef SOCK_CLOEXEC
+	return socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+	const int fd = socket(domain, SOCK_STREAM, 0); // no atomic variant, best effort
+	if (fd >= 0)
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+#endif
+}
+
+int cloexec_accept(int listener)
+{
+#ifdef __linux__
+	return accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+#else
+	const int fd = accept(listener, nullptr, nullptr);
+	if (fd >= 0)
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+#endif
+}
+
+int open_listener(const std::string& address, std::string& unix_path)
+{
+	int fd = -1;
+	if (address.rfind("unix:", 0) == 0) {
+		unix_path = address.substr(5);
+		struct sockaddr_un addr {};
+		if (unix_path.empty() || unix_path.size() >= sizeof(addr.sun_path))
+			throw std::runtime_error("Invalid unix socket path: " + unix_path);
+		addr.sun_family = AF_UNIX;
+		std::strncpy(addr.sun_path, unix_path.c_str(), sizeof(addr.sun_path) - 1);
+		unlink(unix_path.c_str()); // stale socket from a previous run
+		fd = cloexec_socket(AF_UNIX);
+		if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+			throw std::runtime_error("Cannot bind unix socket " + unix_path + ": " + std::strerror(errno));
+	} else {
+		std::string host = "127.0.0.1";
+		std::string port_text = address;
+		const size_t colon = address.rfind(':');
+		if (colon != std::string::npos) {
+			host = address.substr(0, colon);
+			port_text = address.substr(colon + 1);
+			if (host == "localhost")
+				host = "127.0.0.1";
+		}
+		struct sockaddr_in addr {};
+		addr.sin_family = AF_INET;
+		if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 || ntohl(addr.sin_addr.s_addr) != INADDR_LOOPBACK)
+			throw std::runtime_error("Serve mode only binds to localhost, got '" + host + "'");
+		errno = 0;
+		char* end = nullptr;
+		const long port = std::strtol(port_text.c_str(), &end, 10);
+		if (!std::isdigit(static_cast<unsigned char>(port_text.c_str()[0])) || *end != '\0' || errno == ERANGE || port <= 0 || port > 65535)
+			throw std::runtime_error("Invalid port: " + port_text);
+		addr.sin_port = htons(static_cast<uint16_t>(port));
+		fd = cloexec_socket(AF_INET);
+		const int yes = 1;
+		if (fd >= 0)
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+			throw std::runtime_error("Cannot bind " + address + ": " + std::strerror(errno));
+	}
+	if (listen(fd, 64) != 0)
+		throw std::runtime_error(std::string("Cannot listen: ") + std::strerror(errno));
+	return fd;
+}
+
+// One capture and one layout per interval, however many clients there are
+void sampler(SharedState& state, const Config& config, bool use_events, const LayoutOptions& layout)
+{
+	GVC_t* gvc = gvContext();
+	const auto interval = std::chrono::milliseconds(config.serve_interval_ms);
+	std::unique_ptr<ProcessMonitor> monitor;
+	if (use_events) {
+		monitor = std::make_unique<ProcessMonitor>(config);
+		if (!monitor->event_driven())
+			std::cerr << "Warning: Proc connector unavailable, falling back to polling ps.\n";
+	}
+	while (!stop_requested) {
+		auto started = std::chrono::steady_clock::now();
+		try {
+			auto cache = std::make_shared<RenderCache>();
+			// the monitor spends the interval collecting events instead of sleeping
+			auto ps_info = monitor ? monitor->sample(interval) : capture_live();
+			if (monitor && monitor->event_driven())
+				started = std::chrono::steady_clock::now() - interval;
+			sample_process_detail(ps_info, config);
+			cache->captured_at = std::time(nullptr);
+			cache->dot = generate_graph(ps_info, config);
+			LayoutReport report;
+			auto outputs = render_graph_data(gvc, cache->dot, { "svg", "json" }, layout, report);
+			if (!report.abandoned.empty())
+				std::cerr << "Warning: Layout " << describe(report) << std::endl;
+			cache->svg = std::move(outputs[0]);
+			cache->json = std::move(outputs[1]);
+			std::lock_guard<std::mutex> lock(state.mutex);
+			state.latest = std::move(cache);
+		} catch (const std::exception& e) {
+			std::cerr << "Warning: Sampling failed - " << e.what() << std::endl;
+		}
+		std::unique_lock<std::mutex> lock(state.mutex);
+		state.wake.wait_until(lock, started + interval, [] { return stop_requested.load(); });
+	}
+	gvFreeContext(gvc);
+}
+
+void send_all(int fd, const char* data, size_t length)
+{
+	while (length > 0) {
+		const ssize_t n = send(fd, data, length, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return; // client went away, nothing to do
+		data += n;
+		length -= static_cast<size_t>(n);
+	}
+}
+
+void send_response(int fd, const std::string& status, const std::string& content_type, const std::string& body, int64_t captured_at, bool head_only)
+{
+	std::ostringstream header;
+	header << "HTTP/1.1 " << status << "\r\n"
+	       << "Content-Type: " << content_type << "\r\n"
+	       << "Content-Length: " << body.size() << "\r\n"
+	       << "Cache-Control: no-cache\r\n";
+	if (captured_at)
+		header << "X-Captured-At: " << captured_at << "\r\n";
+	header << "Connection: close\r\n\r\n";
+	const std::string head = header.str();
+	send_all(fd, head.data(), head.size());
+	if (!head_only)
+		send_all(fd, body.data(), body.size());
+}
+
+void handle_client(int fd, SharedState& state)
+{
+	struct timeval timeout { CLIENT_TIMEOUT_S, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	// we only care about the request line
+	std::string request;
+	char buffer[1024];
+	while (request.find('\n') == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+		const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			break;
+		request.append(buffer, static_cast<size_t>(n));
+	}
+	std::istringstream request_line(request.substr(0, request.find('\n')));
+	std::string method, path;
+	request_line >> method >> path;
+	path = path.substr(0, path.find('?'));
+
+	std::shared_ptr<const RenderCache> cache;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		cache = state.latest;
+	}
+
+	const bool head_only = (method == "HEAD");
+	if (method != "GET" && !head_only)
+		send_response(fd, "405 Method Not Allowed", "text/plain", "Only GET and HEAD are supported\n", 0, false);
+	else if (!cache)
+		send_response(fd, "503 Service Unavailable", "text/plain", "First capture still in progress\n", 0, head_only);
+	else if (path == "/" || path == "/ptree.svg")
+		send_response(fd, "200 OK", "image/svg+xml", cache->svg, cache->captured_at, head_only);
+	else if (path == "/ptree.dot")
+		send_response(fd, "200 OK", "text/vnd.graphviz", cache->dot, cache->captured_at, head_only);
+	else if (path == "/ptree.json")
+		send_response(fd, "200 OK", "application/json", cache->json, cache->captured_at, head_only);
+	else
+		send_response(fd, "404 Not Found", "text/plain", "Try /ptree.svg, /ptree.dot or /ptree.json\n", 0, head_only);
+	close(fd);
+}
+
+void connection_worker(SharedState& state)
+{
+	while (true) {
+		int fd;
+		{
+			std::unique_lock<std::mutex> lock(state.mutex);
+			state.pending_ready.wait(lock, [&] { return stop_requested || !state.pending.empty(); });
+			if (stop_requested || state.pending.empty())
+				return; // serve() closes whatever is still queued
+			fd = state.pending.front();
+			state.pending.pop_front();
+		}
+		handle_client(fd, state);
+	}
+}
+} // namespace
+
+void serve(const std::string& address, const Config& config, bool use_events, const LayoutOptions& layout)
+{
+	// no SA_RESTART, poll() has to notice
+	struct sigaction action {};
+	action.sa_handler = on_signal;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+
+	std::string unix_path;
+	const int listener = open_listener(address, unix_path);
+	std::cout << "Serving /ptree.svg, /ptree.dot and /ptree.json on " << address
+		  << " (refresh every " << config.serve_interval_ms << " ms)" << std::endl;
+
+	SharedState state;
+	std::thread sampler_thread(sampler, std::ref(state), std::cref(config), use_events, std::cref(layout));
+	std::vector<std::thread> workers;
+	for (int i = 0; i < CONNECTION_WORKERS; ++i)
+		workers.emplace_back(connection_worker, std::ref(state));
+
+	while (!stop_requested) {
+		struct pollfd pfd { listener, POLLIN, 0 };
+		if (poll(&pfd, 1, 500) <= 0)
+			continue;
+		const int client = cloexec_accept(listener);
+		if (client < 0)
+			continue;
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			state.pending.push_back(client);
+		}
+		state.pending_ready.notify_one();
+	}
+
+	// taking the lock first means no waiter can miss the wake-up
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+	}
+	state.wake.notify_all();
+	state.pending_ready.notify_all();
+	sampler_thread.join();
+	for (auto& worker : workers)
+		worker.join();
+	for (int client : state.pending)
+		close(client);
+	state.pending.clear();
+
+	close(listener);
+	if (!unix_path.empty())
+		unlink(unix_path.c_str());
+	std::cout << "Serve mode stopped" << std::endl;
+}
@@ -0,0 +1,17 @@
+#ifndef PS2GV_SERVE_H
+#define PS2GV_SERVE_H
+#include "common/layout.h"
+#include "ps2gv/config-settings.h"
+#include <string>
+
+// Long running mode: re-sample in the background every
+// Config::serve_interval_ms and answer HTTP GETs for the latest
+// /ptree.svg, /ptree.dot or /ptree.json from memory.
+//
+// `address` is either "unix:/path/to.sock" or "[127.0.0.1:|localhost:]port",
+// TCP is only ever bound to the loopback interface. With `use_events` the
+// sampler follows the netlink proc connector instead of re-running ps.
+// Every layout keeps to `layout`'s engine and time budget, falling back to
+// cheaper engines like a single render does.
+void serve(const std::string& address, const Config& config, bool use_events = false, const LayoutOptions& layout = {});
+#endif // PS2GV_SERVE_H
@@ -0,0 +1,120 @@
+#include "ps2gv/snapshot-diff.h"
+#include <cctype>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+bool valid_pid(const ProcessInfo& proc)
+{
+	return !proc.pid.empty() && std::isdigit(proc.pid[0]);
+}
+
+float to_float(const std::string& s)
+{
+	try {
+		return std::stof(s);
+	} catch (...) {
+		return 0.0f;
+	}
+}
+
+// pid alone is not enough, pids get recycled
+std::string join_key(const ProcessInfo& proc)
+{
+	return proc.pid + '\0' + proc.command;
+}
+} // namespace
+
+std::vector<DiffEntry> diff_snapshots(const std::vector<ProcessInfo>& before, const std::vector<ProcessInfo>& after, const Config& config)
+{
+	// build side: before
+	std::unordered_map<std::string, size_t> before_by_key;
+	before_by_key.reserve(before.size());
+	for (size_t i = 0; i < before.size(); ++i)
+		if (valid_pid(before[i]))
+			before_by_key.emplace(join_key(before[i]), i);
+
+	// probe side: after
+	std::vector<DiffEntry> entries;
+	entries.reserve(after.size() + before.size() / 8);
+	std::vector<char> matched(before.size(), 0);
+	for (const auto& proc : after) {
+		if (!valid_pid(proc))
+			continue;
+		DiffEntry entry;
+		entry.proc = proc;
+		const auto it = before_by_key.find(join_key(proc));
+		if (it == before_by_key.end()) {
+			entry.diff_class = DiffClass::New;
+		} else {
+			const ProcessInfo& old = before[it->second];
+			matched[it->second] = 1;
+			entry.rss_delta = to_float(proc.rss) - to_float(old.rss);
+			entry.cpu_delta = to_float(proc.pcpu) - to_float(old.pcpu);
+			if (std::fabs(entry.rss_delta) >= config.diff_rss_delta || std::fabs(entry.cpu_delta) >= config.diff_cpu_delta)
+				entry.diff_class = DiffClass::Changed;
+		}
+		entries.push_back(std::move(entry));
+	}
+	const size_t after_count = entries.size();
+
+	// anything in before that never matched is gone
+	for (size_t i = 0; i < before.size(); ++i) {
+		if (!valid_pid(before[i]) || matched[i])
+			continue;
+		DiffEntry entry;
+		entry.proc = before[i];
+		entry.diff_class = DiffClass::Exited;
+		entries.push_back(std::move(entry));
+	}
+
+	// pid -> entry, exited processes resolve their parents in "before" first
+	std::unordered_map<std::string, size_t> after_by_pid;
+	std::unordered_map<std::string, size_t> exited_by_pid;
+	after_by_pid.reserve(after_count);
+	exited_by_pid.reserve(entries.size() - after_count);
+	for (size_t i = 0; i < entries.size(); ++i)
+		(i < after_count ? after_by_pid : exited_by_pid).emplace(entries[i].proc.pid, i);
+
+	auto parent_of = [&](size_t i) -> long {
+		const std::string& ppid = entries[i].proc.ppid;
+		if (i >= after_count) {
+			const auto it = exited_by_pid.find(ppid);
+			if (it != exited_by_pid.end() && it->second != i)
+				return static_cast<long>(it->second);
+		}
+		const auto it = after_by_pid.find(ppid);
+		if (it != after_by_pid.end() && it->second != i)
+			return static_cast<long>(it->second);
+		return -1;
+	};
+
+	// mark changed processes and walk up to the root, stopping at the first
+	// already kept ancestor so every entry is visited at most once
+	std::vector<char> keep(entries.size(), 0);
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (entries[i].diff_class == DiffClass::Unchanged)
+			continue;
+		long cur = static_cast<long>(i);
+		while (cur >= 0 && !keep[cur]) {
+			keep[cur] = 1;
+			cur = parent_of(cur);
+		}
+	}
+
+	// an exited pid recycled by a new process would collide as a DOT node id
+	for (size_t i = after_count; i < entries.size(); ++i) {
+		const long parent = parent_of(i);
+		if (parent >= static_cast<long>(after_count) && after_by_pid.count(entries[parent].proc.pid))
+			entries[i].proc.ppid += "-exited";
+	}
+	for (size_t i = after_count; i < entries.size(); ++i)
+		if (after_by_pid.count(entries[i].proc.pid))
+			entries[i].proc.pid += "-exited";
+
+	std::vector<DiffEntry> result;
+	for (size_t i = 0; i < entries.size(); ++i)
+		if (keep[i])
+			result.push_back(std::move(entries[i]));
+	return result;
+}
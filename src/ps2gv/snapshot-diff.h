@@ -0,0 +1,25 @@
+#ifndef PS2GV_DIFF_H
+#define PS2GV_DIFF_H
+#include "ps2gv/config-settings.h"
+#include "ps2gv/process-capture.h"
+#include <string>
+#include <vector>
+
+enum class DiffClass {
+	Unchanged, // kept only as an ancestor of something that did change
+	New,
+	Exited,
+	Changed
+};
+
+struct DiffEntry {
+	ProcessInfo proc; // "after" view, or "before" view for exited processes
+	DiffClass diff_class = DiffClass::Unchanged;
+	float rss_delta = 0.0f;
+	float cpu_delta = 0.0f;
+};
+
+// Join both snapshots on (pid, command) and keep only the new, exited and
+// changed processes plus their ancestors. Linear in the size of both inputs.
+std::vector<DiffEntry> diff_snapshots(const std::vector<ProcessInfo>& before, const std::vector<ProcessInfo>& after, const Config& config);
+#endif // PS2GV_DIFF_H